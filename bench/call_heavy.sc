@@ -0,0 +1,38 @@
+; benchmark: call heavy code
+; 10M iterations, each calling a small function with and without a 
+; register window
+
+@segment .code
+
+; R4 = R4 + R5, no window
+@func _accumulate:
+    ADD R4 R4 R5
+    RET
+
+; R4 = R4 * 3 + 1, R5-R6 are saved and restored
+@func _step:
+@window R5 R6
+    MOVL R5 #3
+    LDR R5 R5
+    MUL R4 R4 R5
+    MOVL R6 #1
+    LDR R6 R6
+    ADD R4 R4 R6
+    RET
+
+@entry
+    MOVL R0 #0
+    LDR R0 R0           ; i
+    MOVL R1 #10000000
+    LDR R1 R1           ; n
+    MOVL R2 #1
+    LDR R2 R2
+    MOV R4 R0
+    MOV R5 R2
+_loop:
+    CALL _accumulate
+    CALL _step
+    ADD R0 R0 R2
+    CMP R0 R1
+    JMPNZ _loop
+    HALT
@@ -0,0 +1,30 @@
+; benchmark: float DSP loop
+; one-pole lowpass filter, y = a*y + b*x, over 20M samples of a sawtooth
+
+@segment .code
+
+@entry
+    MOVL R0 #0
+    LDR R0 R0           ; i
+    MOVL R1 #20000000
+    LDR R1 R1           ; n
+    MOVL R2 #1
+    LDR R2 R2
+    MOVL R6 #255
+    LDR R6 R6           ; sawtooth period
+    MOVL R8 #0.0
+    LDR R8 R8           ; y
+    MOVL R9 #0.01
+    LDR R9 R9           ; b
+    MOVL R10 #0.99
+    LDR R10 R10         ; a
+_loop:
+    AND R5 R0 R6        ; x = i & 255
+    ITOF R5 R5
+    MULF R7 R5 R9       ; b*x
+    MULF R8 R8 R10      ; a*y
+    ADDF R8 R8 R7       ; y = a*y + b*x
+    ADD R0 R0 R2
+    CMP R0 R1
+    JMPNZ _loop
+    HALT
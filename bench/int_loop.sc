@@ -0,0 +1,20 @@
+; benchmark: tight integer loop
+; 50M iterations of add, xor, and compare
+
+@segment .code
+
+@entry
+    MOVL R0 #0
+    LDR R0 R0           ; i
+    MOVL R1 #50000000
+    LDR R1 R1           ; n
+    MOVL R2 #1
+    LDR R2 R2
+    MOV R3 R0           ; acc
+_loop:
+    ADD R3 R3 R0
+    XOR R3 R3 R2
+    ADD R0 R0 R2
+    CMP R0 R1
+    JMPNZ _loop
+    HALT
@@ -0,0 +1,64 @@
+#!/bin/sh
+# This file is part of {{ samplecontrol }}.
+#
+# Run the benchmark suite, see make bench.
+#
+# Each bench/*.sc is assembled with scasm and run with scem --nosleep --bench, 
+# which reports instructions, seconds, instructions/sec, ns per op, and max
+# resident memory as one JSON object per line. Results are written to 
+# build_dir/bench.jsonl and, if a baseline from a previous run is given, 
+# compared against it.
+#
+# usage: run.sh build_dir [baseline.jsonl]
+
+BUILD_DIR=${1:-./build/release}
+BASELINE=$2
+BENCH_DIR=$(dirname "$0")
+RESULTS=$BUILD_DIR/bench.jsonl
+
+: > "$RESULTS"
+
+for src in "$BENCH_DIR"/*.sc; do
+    name=$(basename "$src" .sc)
+    rom=$BUILD_DIR/$name.scrom
+
+    if ! "$BUILD_DIR/scasm" "$src" "$rom" > "$BUILD_DIR/$name.scasm.log" 2>&1; then
+        echo "ERROR: failed to assemble $src, see $BUILD_DIR/$name.scasm.log" >&2
+        exit 1
+    fi
+
+    case $name in
+        screen_*)
+            # no display on build machines, render offscreen
+            "$BUILD_DIR/scem" --nosleep --bench --headless "$rom" ;;
+        *)
+            "$BUILD_DIR/scem" --nosleep --bench "$rom" ;;
+    esac | grep '^{"rom"' >> "$RESULTS"
+done
+
+cat "$RESULTS"
+
+if [ -n "$BASELINE" ]; then
+    # ns per op for each rom, baseline vs current
+    awk '
+        function field(line, key,    s) {
+            s = line
+            sub(".*\"" key "\":\"?", "", s)
+            sub("[\",}].*", "", s)
+            return s
+        }
+        {
+            rom = field($0, "rom"); sub(".*/", "", rom)
+            ns = field($0, "ns_per_op")
+            if (FILENAME == ARGV[1]) { base[rom] = ns } else { current[rom] = ns }
+        }
+        END {
+            printf "%-28s %12s %12s %9s\n", "benchmark", "baseline ns", "current ns", "change"
+            for (rom in current) {
+                if (rom in base && base[rom] > 0) {
+                    printf "%-28s %12.3f %12.3f %+8.1f%%\n", rom, base[rom], current[rom], 
+                        100.0 * (current[rom] - base[rom]) / base[rom]
+                }
+            }
+        }' "$BASELINE" "$RESULTS"
+fi
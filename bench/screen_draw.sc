@@ -0,0 +1,61 @@
+; benchmark: screen drawing
+; 300 frames, each clearing the screen and drawing 2048 pixels and 64 rects
+
+@segment .code
+
+@task _draw:
+    MOVL R0 #0
+    LDR R0 R0           ; frame
+    MOVL R1 #300
+    LDR R1 R1           ; frames
+    MOVL R2 #1
+    LDR R2 R2
+    MOVL R3 #2048
+    LDR R3 R3           ; pixels per frame
+    MOVL R4 #64
+    LDR R4 R4           ; rects per frame
+    MOVL R5 #255
+    LDR R5 R5           ; x mask
+    MOVL R6 #8
+    LDR R6 R6           ; y shift, rect size
+    MOVL R12 #0
+    LDR R12 R12
+_frame:
+    .Screen/begin
+    .Screen/colour R12
+    .Screen/fill
+    .Screen/colour R2
+    MOV R7 R12
+_pixels:
+    AND R8 R7 R5        ; x = i & 255
+    SHIFTR R9 R7 R6     ; y = i >> 8
+    ADD R9 R9 R0
+    .Screen/pixel R8 R9
+    ADD R7 R7 R2
+    CMP R7 R3
+    JMPNZ _pixels
+    MOV R7 R12
+_rects:
+    SHIFTL R8 R7 R6     ; x = i << 3
+    .Screen/move R8 R0
+    .Screen/rect R6 R6
+    ADD R7 R7 R2
+    CMP R7 R4
+    JMPNZ _rects
+    .Screen/end
+    YIELD
+    ADD R0 R0 R2
+    CMP R0 R1
+    JMPNZ _frame
+    HALT
+
+@entry
+    MOVL R0 #320
+    LDR R0 R0
+    MOVL R1 #240
+    LDR R1 R1
+    .Screen/resize R0 R1
+    MOVL R0 #60
+    LDR R0 R0
+    SPAWN R0 _draw
+    START
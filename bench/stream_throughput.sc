@@ -0,0 +1,36 @@
+; benchmark: stream producer/consumer throughput
+; 20K rounds of writing 512 values into a stream and then reading them back
+
+@segment .code
+
+@entry
+    MOVL R0 #48000
+    LDR R0 R0
+    @stream S0 #32 R0 #0
+    MOVL R0 #0
+    LDR R0 R0           ; round
+    MOVL R1 #20000
+    LDR R1 R1           ; rounds
+    MOVL R2 #1
+    LDR R2 R2
+    MOVL R3 #512
+    LDR R3 R3           ; values per round
+_round:
+    MOVL R4 #0
+    LDR R4 R4
+_produce:
+    SWRITE S0 R4        ; producer
+    ADD R4 R4 R2
+    CMP R4 R3
+    JMPNZ _produce
+    MOVL R4 #0
+    LDR R4 R4
+_consume:
+    SREAD R5 S0         ; consumer
+    ADD R4 R4 R2
+    CMP R4 R3
+    JMPNZ _consume
+    ADD R0 R0 R2
+    CMP R0 R1
+    JMPNZ _round
+    HALT
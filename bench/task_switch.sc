@@ -0,0 +1,25 @@
+; benchmark: task switching
+; a task that yields back to the scheduler 1M times, run with --nosleep 
+; this measures the cost of YIELD
+
+@segment .code
+
+@task _worker:
+    MOVL R0 #0
+    LDR R0 R0           ; i
+    MOVL R1 #1000000
+    LDR R1 R1           ; n
+    MOVL R2 #1
+    LDR R2 R2
+_loop:
+    YIELD
+    ADD R0 R0 R2
+    CMP R0 R1
+    JMPNZ _loop
+    HALT
+
+@entry
+    MOVL R0 #48000
+    LDR R0 R0
+    SPAWN R0 _worker
+    START
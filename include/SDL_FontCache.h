@@ -108,6 +108,15 @@ typedef struct FC_GlyphData
 
 } FC_GlyphData;
 
+/*! A laid out glyph, 'src' is in the glyph cache texture at 'cache_level', 'dst' is relative to the text's origin. */
+typedef struct FC_GlyphQuad
+{
+    FC_Rect src;
+    FC_Rect dst;
+    int cache_level;
+
+} FC_GlyphQuad;
+
 
 
 
@@ -134,12 +143,18 @@ Uint8 FC_LoadFont(FC_Font* font, const char* filename_ttf, Uint32 pointSize, SDL
 
 Uint8 FC_LoadFontFromTTF(FC_Font* font, TTF_Font* ttf, SDL_Color color);
 
+/*! Loads a font from a prebuilt glyph atlas, uploaded as cache level 0.  Metrics are as reported by SDL_ttf.  Glyphs must then be added with FC_SetGlyphData.  If ttf is not NULL then the font owns it and glyphs that are not in the atlas are rendered from it, otherwise they are not rendered. */
+Uint8 FC_LoadFontFromAtlas(FC_Font* font, SDL_Surface* atlas, TTF_Font* ttf, int height, int ascent, int descent, SDL_Color color);
+
 Uint8 FC_LoadFont_RW(FC_Font* font, SDL_RWops* file_rwops_ttf, Uint8 own_rwops, Uint32 pointSize, SDL_Color color, int style);
 #else
 Uint8 FC_LoadFont(FC_Font* font, SDL_Renderer* renderer, const char* filename_ttf, Uint32 pointSize, SDL_Color color, int style);
 
 Uint8 FC_LoadFontFromTTF(FC_Font* font, SDL_Renderer* renderer, TTF_Font* ttf, SDL_Color color);
 
+/*! Loads a font from a prebuilt glyph atlas, uploaded as cache level 0.  Metrics are as reported by SDL_ttf.  Glyphs must then be added with FC_SetGlyphData.  If ttf is not NULL then the font owns it and glyphs that are not in the atlas are rendered from it, otherwise they are not rendered. */
+Uint8 FC_LoadFontFromAtlas(FC_Font* font, SDL_Renderer* renderer, SDL_Surface* atlas, TTF_Font* ttf, int height, int ascent, int descent, SDL_Color color);
+
 Uint8 FC_LoadFont_RW(FC_Font* font, SDL_Renderer* renderer, SDL_RWops* file_rwops_ttf, Uint8 own_rwops, Uint32 pointSize, SDL_Color color, int style);
 #endif
 
@@ -257,7 +272,7 @@ void FC_GetCodepoints(FC_Font* font, Uint32* result);
 /*! Stores the glyph data for the given codepoint in 'result'.  Returns 0 if the codepoint was not found in the cache. */
 Uint8 FC_GetGlyphData(FC_Font* font, FC_GlyphData* result, Uint32 codepoint);
 
-/*! Sets the glyph data for the given codepoint.  Duplicates are not checked.  Returns a pointer to the stored data. */
+/*! Sets the glyph data for the given codepoint, replacing any existing data.  Returns a pointer to the stored data, which is valid until the next glyph is added. */
 FC_GlyphData* FC_SetGlyphData(FC_Font* font, Uint32 codepoint, FC_GlyphData glyph_data);
 
 
@@ -269,6 +284,13 @@ FC_Rect FC_DrawScale(FC_Font* font, FC_Target* dest, float x, float y, FC_Scale
 FC_Rect FC_DrawColor(FC_Font* font, FC_Target* dest, float x, float y, SDL_Color color, const char* formatted_text, ...);
 FC_Rect FC_DrawEffect(FC_Font* font, FC_Target* dest, float x, float y, FC_Effect effect, const char* formatted_text, ...);
 
+/*! Draws 'text' as is, i.e. it is not used as a format string. */
+FC_Rect FC_DrawText(FC_Font* font, FC_Target* dest, float x, float y, const char* text);
+
+/*! Lays out 'text', unformatted, as FC_DrawText() would draw it at (0,0).  Up to 'max_quads' glyphs are stored in 'result', 
+    spaces are skipped.  'bounds' is set to the union of all glyphs.  Returns the number of glyphs, which may be more than 'max_quads'. */
+int FC_GetGlyphQuads(FC_Font* font, const char* text, FC_GlyphQuad* result, int max_quads, FC_Rect* bounds);
+
 FC_Rect FC_DrawBox(FC_Font* font, FC_Target* dest, FC_Rect box, const char* formatted_text, ...);
 FC_Rect FC_DrawBoxAlign(FC_Font* font, FC_Target* dest, FC_Rect box, FC_AlignEnum align, const char* formatted_text, ...);
 FC_Rect FC_DrawBoxScale(FC_Font* font, FC_Target* dest, FC_Rect box, FC_Scale scale, const char* formatted_text, ...);
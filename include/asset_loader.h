@@ -0,0 +1,94 @@
+/* This file is part of {{ samplecontrol }}.
+ *
+ * 2024 Benedict R. Gaster (cuberoo_)
+ *
+ * Licensed under either of
+ * Apache License, Version 2.0 (LICENSE-APACHE or http://www.apache.org/licenses/LICENSE-2.0)
+ * MIT license (LICENSE-MIT or http://opensource.org/licenses/MIT)
+ * at your option.
+ */
+#ifndef ASSET_LOADER_HEADER_H
+#define ASSET_LOADER_HEADER_H
+
+#include <util.h>
+#include <font_atlas.h>
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+
+// Fonts and images are loaded in three steps, each on its own thread. The VM
+// thread adds a job, a worker thread reads and decodes the file into surfaces,
+// and the render thread uploads them as textures. Jobs are handled in the
+// order they were added.
+
+enum { ASSET_FONT=0, ASSET_IMAGE };
+
+#define ASSET_MAX_PATH 256
+
+typedef struct {
+    sc_uint kind_;
+    sc_ushort index_;           // slot
+    sc_ushort point_;           // fonts only
+    sc_uint colour_;            // fonts only, ARGB
+    sc_int rom_atlas_;          // fonts only, atlas baked into the ROM, or -1 to load path
+    sc_char path_[ASSET_MAX_PATH];
+
+    // filled in by the worker, owned by the job until taken by the render thread
+    sc_bool ok_;
+    SDL_Surface * surface_;     // image, or glyph atlas of font, 32-bit ARGB
+    font_atlas atlas_;          // fonts only, glyphs and metrics of surface_
+    TTF_Font * ttf_;            // fonts only, for glyphs that are not in the atlas
+} asset_job;
+
+/**
+ * @brief start the worker thread
+ *
+ * @return true if successful, otherwise false
+ */
+sc_bool init_asset_loader();
+
+/**
+ * @brief stop the worker thread and free jobs that were not taken
+ */
+void delete_asset_loader();
+
+/**
+ * @brief add job, VM thread only, waits if too many jobs are in flight
+ *
+ * only the request fields, up to path_, are used
+ */
+void asset_loader_push(const asset_job * job);
+
+/**
+ * @brief get next decoded job, render thread only
+ *
+ * @return job, which stays valid until asset_loader_pop(), or NULL if none
+ */
+asset_job * asset_loader_peek();
+
+/**
+ * @brief free what is left in the job from asset_loader_peek() and remove it,
+ * set any fields that were taken to NULL first
+ */
+void asset_loader_pop();
+
+/**
+ * @brief true if any jobs have not been popped yet, any thread
+ */
+sc_bool asset_loader_busy();
+
+/**
+ * @brief expand coverage of atlas into a white 32-bit ARGB surface
+ */
+SDL_Surface * font_atlas_surface(const font_atlas * atlas);
+
+/**
+ * @brief lock held while FreeType faces are opened or closed
+ *
+ * SDL_ttf faces may be used on different threads, but not opened and closed
+ * at the same time, so the render thread holds this while freeing a font
+ * that owns its TTF
+ */
+void lock_fonts();
+void unlock_fonts();
+
+#endif // ASSET_LOADER_HEADER_H
@@ -11,6 +11,12 @@
 #define DEVICE_HEADER_H
 
 #include <util.h>
+#include <lfqueue.h>
+
+// console input modes, see attach_console_input_generator
+#define CONSOLE_INPUT_BYTES 0   // each byte is sent as it is read
+#define CONSOLE_INPUT_LINES 1   // bytes are sent a whole line at a time, including its newline
+#define CONSOLE_INPUT_EOF 0xFFFFFFFF    // sent once stdin is closed
 
 /**
  * @brief check to see if current build has console device
@@ -40,7 +46,43 @@ sc_bool init_console();
 sc_bool write_console(sc_char ch);
 
 /**
- * @brief deinitialize console device
+ * @brief write length chars of str to console device, as write_console
+ *
+ *  output is buffered and written out by another thread, if the buffer is
+ *  full what does not fit is lost, rather than waiting
+ */
+sc_bool write_console_string(const sc_char * str, sc_uint length);
+
+/**
+ * @brief write value in decimal to console device, as write_console_string
+ */
+sc_bool write_console_int(sc_int value);
+
+/**
+ * @brief write value to console device, as printf %g, as write_console_string
+ */
+sc_bool write_console_float(sc_float value);
+
+/**
+ * @brief send bytes read from stdin to stream, one byte per word
+ *
+ *  stdin is read on a background thread, so the VM never waits for input,
+ *  words are not lost if the stream is full, reading waits instead, and
+ *  CONSOLE_INPUT_EOF is sent at the end
+ *
+ * @param queue of stream
+ * @param mode CONSOLE_INPUT_BYTES or CONSOLE_INPUT_LINES
+ * @return true if reading started, otherwise false
+ */
+sc_bool attach_console_input_generator(sc_queue * queue, sc_uint mode);
+
+/**
+ * @brief bytes written to console device, and lost as its buffer was full
+ */
+void console_stats(unsigned long long * bytes, unsigned long long * lost);
+
+/**
+ * @brief deinitialize console device, after writing out anything buffered
  * 
  * @param a non null pointer, that was used in a corresponding call to 
  *        init_console
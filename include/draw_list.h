@@ -0,0 +1,91 @@
+/* This file is part of {{ samplecontrol }}.
+ *
+ * 2024 Benedict R. Gaster (cuberoo_)
+ *
+ * Licensed under either of
+ * Apache License, Version 2.0 (LICENSE-APACHE or http://www.apache.org/licenses/LICENSE-2.0)
+ * MIT license (LICENSE-MIT or http://opensource.org/licenses/MIT)
+ * at your option.
+ */
+#ifndef DRAW_LIST_HEADER_H
+#define DRAW_LIST_HEADER_H
+
+#include <util.h>
+
+// commands recorded by the screen device between SCREEN_BEGIN and SCREEN_END
+enum { DRAW_FILL=0, DRAW_PIXEL, DRAW_RECT, DRAW_TEXT, DRAW_BLIT, DRAW_BLIT_INDEXED, DRAW_IMAGE };
+
+typedef struct {
+    sc_uchar kind_;
+    sc_uchar colour_;       // palette index
+    sc_ushort font_;        // DRAW_TEXT font, or DRAW_IMAGE image slot
+    sc_short x_;
+    sc_short y_;
+    sc_ushort w_;           // DRAW_RECT and blits only
+    sc_ushort h_;           // DRAW_RECT and blits only
+    sc_uint data_;          // DRAW_TEXT and blits only, offset of string or pixels in data_
+} draw_command;
+
+typedef struct {
+    draw_command * commands_;
+    sc_uint count_;
+    sc_uint capacity_;
+    sc_uchar * data_;       // NUL terminated strings and blitted pixels
+    sc_uint data_length_;
+    sc_uint data_capacity_;
+} draw_list;
+
+draw_list * allocate_draw_list();
+void delete_draw_list(draw_list * list);
+
+/**
+ * @brief remove all commands, memory is kept for the next frame
+ */
+void draw_list_reset(draw_list * list);
+
+/**
+ * @brief record fill of the whole screen
+ *
+ * as fill covers everything drawn before it, any earlier commands are dropped
+ */
+void draw_list_fill(draw_list * list, sc_uchar colour);
+void draw_list_pixel(draw_list * list, sc_uchar colour, sc_short x, sc_short y);
+void draw_list_rect(draw_list * list, sc_uchar colour, sc_short x, sc_short y, sc_ushort w, sc_ushort h);
+
+/**
+ * @brief record framebuffer rectangle, drawn at the same position on screen
+ *
+ * the rectangle's pixels are copied, w * h 32-bit ARGB pixels for DRAW_BLIT 
+ * or 8-bit palette indices for DRAW_BLIT_INDEXED
+ *
+ * @param DRAW_BLIT or DRAW_BLIT_INDEXED
+ * @param first pixel of the rectangle
+ * @param bytes between rows of pixels
+ */
+void draw_list_blit(draw_list * list, sc_uchar kind, sc_short x, sc_short y, sc_ushort w, sc_ushort h, 
+                    const void * pixels, sc_uint pitch);
+
+/**
+ * @brief make dst a copy of src
+ */
+void draw_list_copy(draw_list * dst, const draw_list * src);
+
+/**
+ * @brief record text, str is copied so it need only be valid during the call
+ */
+void draw_list_text(draw_list * list, sc_uchar colour, sc_ushort font, sc_short x, sc_short y, const sc_char * str);
+
+/**
+ * @brief record image slot, drawn at its own size with its top left at x, y
+ */
+void draw_list_image(draw_list * list, sc_ushort image, sc_short x, sc_short y);
+
+static inline const sc_char * draw_command_text(const draw_list * list, const draw_command * command) {
+    return (const sc_char *)(list->data_ + command->data_);
+}
+
+static inline const void * draw_command_pixels(const draw_list * list, const draw_command * command) {
+    return list->data_ + command->data_;
+}
+
+#endif // DRAW_LIST_HEADER_H
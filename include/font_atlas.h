@@ -0,0 +1,82 @@
+/* This file is part of {{ samplecontrol }}.
+ *
+ * 2024 Benedict R. Gaster (cuberoo_)
+ *
+ * Licensed under either of
+ * Apache License, Version 2.0 (LICENSE-APACHE or http://www.apache.org/licenses/LICENSE-2.0)
+ * MIT license (LICENSE-MIT or http://opensource.org/licenses/MIT)
+ * at your option.
+ */
+#ifndef FONT_ATLAS_HEADER_H
+#define FONT_ATLAS_HEADER_H
+
+#include <util.h>
+#include <stdio.h>
+#include <SDL2/SDL_ttf.h>
+
+// Glyph atlases are rasterized by scasm, for each @font directive, and stored
+// in the ROM after the code. A font loaded at run time, with the same path and
+// point size, is then created from the atlas rather than from the TTF.
+
+#define FONT_ATLAS_MAGIC 0x464F4E54     // "FONT"
+#define FONT_ATLAS_MAX_PATH 256
+#define FONT_ATLAS_PADDING 1            // pixels around each glyph, as SDL_FontCache
+
+typedef struct {
+    sc_uint codepoint_;
+    sc_ushort x_;
+    sc_ushort y_;
+    sc_ushort w_;
+    sc_ushort h_;
+} font_atlas_glyph;
+
+typedef struct {
+    sc_char path_[FONT_ATLAS_MAX_PATH]; // as passed to .Screen/font
+    sc_ushort point_;
+    sc_short height_;                   // metrics as reported by SDL_ttf
+    sc_short ascent_;
+    sc_short descent_;
+    sc_ushort width_;                   // atlas size in pixels
+    sc_ushort rows_;
+    sc_uint glyph_count_;
+    font_atlas_glyph * glyphs_;
+    sc_uchar * coverage_;               // width_ * rows_ alpha values, row major
+} font_atlas;
+
+/**
+ * @brief rasterize printable ASCII and Latin-1 glyphs of font into atlas
+ *
+ * @param path of TTF
+ * @param point size
+ * @param non null pointer to atlas to fill in
+ * @return true if successful, otherwise false
+ */
+sc_bool bake_font_atlas(const sc_char * path, sc_ushort point, font_atlas * atlas);
+
+/**
+ * @brief as bake_font_atlas, for a font that is already open, which is left open
+ */
+sc_bool bake_font_atlas_from_ttf(TTF_Font * ttf, const sc_char * path, sc_ushort point, font_atlas * atlas);
+
+/**
+ * @brief write atlases to file, at its current position
+ *
+ * @return true if successful, otherwise false
+ */
+sc_bool write_font_atlases(FILE * file, const font_atlas * atlases, sc_uint count);
+
+/**
+ * @brief read atlases written by write_font_atlases, from file's current position
+ *
+ * @param file
+ * @param non null pointer to where number of atlases will be returned
+ * @return atlases, to be freed with delete_font_atlases, or NULL on error
+ */
+font_atlas * read_font_atlases(FILE * file, sc_uint * count);
+
+/**
+ * @brief free glyphs and coverage of each atlas, and the array itself
+ */
+void delete_font_atlases(font_atlas * atlases, sc_uint count);
+
+#endif // FONT_ATLAS_HEADER_H
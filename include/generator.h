@@ -0,0 +1,75 @@
+/* This file is part of {{ samplecontrol }}.
+ *
+ * 2024 Benedict R. Gaster (cuberoo_)
+ *
+ * Licensed under either of
+ * Apache License, Version 2.0 (LICENSE-APACHE or http://www.apache.org/licenses/LICENSE-2.0)
+ * MIT license (LICENSE-MIT or http://opensource.org/licenses/MIT)
+ * at your option.
+ */
+#ifndef GENERATOR_HEADER_H
+#define GENERATOR_HEADER_H
+
+#include <util.h>
+#include <lfqueue.h>
+
+#include <stdatomic.h>
+
+// A generator feeds a stream from a device, e.g. the mouse, at the rate set for
+// the stream with @stream. Samples, such as a position, that arrive faster than
+// the rate are coalesced and only the latest is sent. Events, such as a button
+// press, are always sent, after any sample that is waiting, so order is kept.
+
+// SETSC flags, i.e. last operand of @stream
+#define STREAM_CONTINUOUS 1     // send the last sample every period, even if it has not changed
+#define STREAM_LATEST 2         // only send a sample when the stream is empty, so it is never stale
+
+#define DEFAULT_SAMPLE_RATE 48000   // SR
+
+typedef struct {
+    _Atomic(sc_queue *) queue_;
+    atomic_uint rate_;          // samples per second, 0 to send every sample
+    atomic_uint flags_;
+
+    // device side only
+    unsigned long long next_ns_;
+    sc_bool held_;              // sample waiting for the next period
+    sc_bool sent_;              // value_ has been sent at least once
+    sc_uint value_;
+    unsigned long long coalesced_;
+    unsigned long long dropped_;    // events lost as stream was full
+} sc_generator;
+
+/**
+ * @brief connect generator to queue, any thread
+ *
+ * @param generator
+ * @param queue of stream, or NULL to disconnect
+ * @param rate of stream
+ * @param flags of stream
+ */
+void attach_generator(sc_generator * generator, sc_queue * queue, sc_uint rate, sc_uint flags);
+
+/**
+ * @brief true if attached to a stream
+ */
+sc_bool generator_attached(sc_generator * generator);
+
+/**
+ * @brief value that replaces any previous sample not yet sent, device side only
+ *
+ * @param now monotonic time in nanoseconds
+ */
+void generator_sample(sc_generator * generator, sc_uint value, unsigned long long now);
+
+/**
+ * @brief value that must not be coalesced, device side only
+ */
+void generator_event(sc_generator * generator, sc_uint value);
+
+/**
+ * @brief send sample if its period is due, device side only, call often
+ */
+void generator_tick(sc_generator * generator, unsigned long long now);
+
+#endif // GENERATOR_HEADER_H
@@ -0,0 +1,36 @@
+/* This file is part of {{ samplecontrol }}.
+ *
+ * 2024 Benedict R. Gaster (cuberoo_)
+ *
+ * Licensed under either of
+ * Apache License, Version 2.0 (LICENSE-APACHE or http://www.apache.org/licenses/LICENSE-2.0)
+ * MIT license (LICENSE-MIT or http://opensource.org/licenses/MIT)
+ * at your option.
+ */
+#ifndef PALETTE_HEADER_H
+#define PALETTE_HEADER_H
+
+#include <util.h>
+
+#define PALETTE_SIZE 256
+
+// palette entries are 32-bit ARGB
+#define PALETTE_A(c) (((c) >> 24) & 0xFF)
+#define PALETTE_R(c) (((c) >> 16) & 0xFF)
+#define PALETTE_G(c) (((c) >> 8) & 0xFF)
+#define PALETTE_B(c) ((c) & 0xFF)
+
+/**
+ * @brief expand 8-bit palette indices to 32-bit ARGB
+ *
+ * uses AVX2 gathers when the CPU supports them, otherwise an unrolled 
+ * scalar loop
+ *
+ * @param count indices
+ * @param count pixels
+ * @param number of indices to expand
+ * @param PALETTE_SIZE entries
+ */
+void palette_expand(const sc_uchar * src, sc_uint * dst, sc_uint count, const sc_uint * palette);
+
+#endif // PALETTE_HEADER_H
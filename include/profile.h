@@ -0,0 +1,73 @@
+/* This file is part of {{ samplecontrol }}.
+ *
+ * 2024 Benedict R. Gaster (cuberoo_)
+ *
+ * Licensed under either of
+ * Apache License, Version 2.0 (LICENSE-APACHE or http://www.apache.org/licenses/LICENSE-2.0)
+ * MIT license (LICENSE-MIT or http://opensource.org/licenses/MIT)
+ * at your option.
+ */
+#ifndef PROFILE_HEADER_H
+#define PROFILE_HEADER_H
+
+#include <util.h>
+
+// devices that can be timed by the profiler
+enum { PROFILE_DEVICE_CONSOLE=0, PROFILE_DEVICE_SCREEN, PROFILE_NUM_DEVICES };
+
+// max commands per device that are timed separately
+#define PROFILE_MAX_DEVICE_COMMANDS 32
+
+/**
+ * @brief check to see if current build has profiling support
+ * @return true if scem was built with __PROFILE__ enabled
+ */
+sc_bool has_profiler();
+
+/**
+ * @brief enable profiling for this run
+ *
+ * the report is written, at exit, to rom.prof and folded stacks to rom.folded,
+ * if rom.sym exists (see scasm -g) then it is used to name functions and tasks
+ *
+ * @param path of the ROM being profiled
+ * @param if true then time each device call
+ * @return true if profiling is enabled, otherwise false
+ */
+sc_bool enable_profiler(const sc_char * rom, sc_bool time_devices);
+
+void profile_task(sc_uint task_id, sc_uint pc);
+void profile_instruction(sc_uint task_id, sc_uint pc, sc_uint opcode);
+void profile_call(sc_uint task_id, sc_uint pc_target);
+void profile_ret(sc_uint task_id);
+void profile_device_begin();
+void profile_device_end(sc_uint device, sc_uint command);
+
+/**
+ * @brief write profile report and folded stacks
+ *
+ * called automatically at exit, once profiling is enabled
+ */
+void write_profile();
+
+//------------------------------------------------------------------
+// hooks used by the VM, these compile away unless __PROFILE__ is set
+//------------------------------------------------------------------
+
+#if defined(__PROFILE__) && __PROFILE__ > 0
+ #define PROFILE_TASK(id, pc) profile_task(id, pc)
+ #define PROFILE_INSTRUCTION(id, pc, opcode) profile_instruction(id, pc, opcode)
+ #define PROFILE_CALL(id, pc) profile_call(id, pc)
+ #define PROFILE_RET(id) profile_ret(id)
+ #define PROFILE_DEVICE_BEGIN() profile_device_begin()
+ #define PROFILE_DEVICE_END(device, command) profile_device_end(device, command)
+#else
+ #define PROFILE_TASK(id, pc) /* Don't do anything in non profiling builds */
+ #define PROFILE_INSTRUCTION(id, pc, opcode)
+ #define PROFILE_CALL(id, pc)
+ #define PROFILE_RET(id)
+ #define PROFILE_DEVICE_BEGIN()
+ #define PROFILE_DEVICE_END(device, command)
+#endif
+
+#endif // PROFILE_HEADER_H
@@ -12,6 +12,49 @@
 
 #include <util.h>
 #include <lfqueue.h>
+#include <generator.h>
+#include <font_atlas.h>
+
+// The screen device is split across two threads. The VM thread calls the 
+// drawing functions, which record commands into a frame, and screen_end_frame()
+// publishes the frame. The main thread, which owns the window, runs screen_run() 
+// to handle events and render the latest published frame. A frame that is 
+// replaced before it is rendered is dropped.
+
+// font and image slot status, see screen_font_status
+enum { ASSET_EMPTY=0, ASSET_LOADING, ASSET_READY, ASSET_FAILED };
+
+// frame timings, a frame is from taking a published frame to the end of 
+// present, on the render thread
+typedef struct {
+    unsigned long long frames_;
+    unsigned long long frames_published_;
+    unsigned long long frames_dropped_; // published but replaced before rendering
+    unsigned long long frame_ns_last_;
+    unsigned long long frame_ns_min_;
+    unsigned long long frame_ns_max_;
+    unsigned long long frame_ns_total_;
+    sc_uint draw_commands_last_;   // pixels, rects, fills, and text recorded last frame
+    sc_uint draw_calls_last_;      // SDL draw calls used to render them
+    sc_uint damage_pixels_last_;   // area redrawn last frame
+    unsigned long long frames_skipped_; // unchanged frames in retained mode
+    unsigned long long frames_late_;    // rendered after their deadline, see screen_set_rate
+    unsigned long long frame_period_ns_;   // 0 if frames are not paced
+    unsigned long long interval_ns_last_;  // between rendered frames
+    unsigned long long interval_ns_min_;
+    unsigned long long interval_ns_max_;
+    unsigned long long interval_ns_total_;
+    sc_bool vsync_;                // present waits for the display
+    unsigned long long text_hits_;      // text drawn or measured from already laid out runs
+    unsigned long long text_misses_;
+    unsigned long long fonts_baked_;        // loaded from atlases in the ROM
+    unsigned long long fonts_rasterized_;   // loaded from a TTF
+    unsigned long long font_load_ns_;       // total time spent uploading fonts, on the render thread
+    unsigned long long images_loaded_;
+    unsigned long long events_coalesced_;   // mouse samples replaced before being sent, see generator.h
+    unsigned long long events_dropped_;     // mouse events lost as the stream was full
+    sc_uint framebuffer_hash_;     // FNV-1a of current framebuffer, headless only
+} screen_stats;
 
 /**
  * @brief check to see if current build has screen device
@@ -25,23 +68,211 @@ sc_bool has_screen_device();
  * @return true if screen is initialized correctly, otherwise false
  */
 sc_bool init_screen();
+
+/**
+ * @brief initialize screen device without a display
+ *
+ * renders into an in-memory software framebuffer, all other screen_* functions
+ * behave as they do for a window
+ *
+ * @param if not NULL then each frame is written to dir/frame_NNNNNN.bmp
+ * @return true if screen is initialized correctly, otherwise false
+ */
+sc_bool init_headless_screen(const sc_char * frame_dir);
+
+/**
+ * @brief handle events and render frames until screen_stop()
+ *
+ * must be called from the thread that initialized the screen, while the VM 
+ * runs on another thread
+ */
+void screen_run();
+
+/**
+ * @brief stop screen_run(), once any frame still waiting has been rendered
+ *
+ * called from the VM thread when it finishes
+ */
+void screen_stop();
+
+/**
+ * @brief get frame timings, after screen_run() has returned
+ *
+ * @param non null pointer to where stats will be returned
+ * @return true if at least one frame has been presented, otherwise false
+ */
+sc_bool screen_frame_stats(screen_stats * dst);
+
+/**
+ * @brief set max frames per second that are rendered, default 30
+ *
+ * frames are rendered at most once per period, always the latest published
+ * frame, and any published in between are dropped. The VM never waits for 
+ * the display. If present is synchronized with the display then frames are
+ * also never rendered faster than the display's refresh rate. If rendering 
+ * falls behind then the next deadline is reset from now, rather than trying 
+ * to catch up.
+ *
+ * @param frames per second, 0 to render each frame as soon as it is published
+ */
 void screen_set_rate(sc_int fps);
 sc_bool screen_should_close();
 void screen_begin_frame();
+
+/**
+ * @brief publish frame for the render thread, never waits for rendering 
+ * unless frames are being dumped
+ */
 void screen_end_frame();
+
+/**
+ * @brief handle window events, render thread only
+ */
 sc_bool screen_process_events();
-sc_bool attach_mouse_generator(sc_queue * queue);
+
+/**
+ * @brief connect mouse to stream, motion is sent at most rate times a second
+ *
+ * @param queue of stream
+ * @param rate of stream, from SETSF
+ * @param flags of stream, from SETSC, see STREAM_LATEST
+ */
+sc_bool attach_mouse_generator(sc_queue * queue, sc_uint rate, sc_uint flags);
+
+// keyboard stream words, top 2 bits are 11
+//     bit 29 is 1 for text input, then bottom 21 bits are a Unicode codepoint
+//     bit 29 is 0 for a key, then
+//         bit 28 is 1 for down, 0 for up, bit 27 is 1 if down is a repeat
+//         bits 16-20 are modifiers, see KEY_MOD_SHIFT
+//         bottom 16 bits are the SDL scancode, i.e. position on the keyboard
+#define KEY_EVENT       0xC0000000
+#define KEY_TEXT        (1 << 29)
+#define KEY_DOWN        (1 << 28)
+#define KEY_REPEAT      (1 << 27)
+#define KEY_MOD_SHIFT   (1 << 16)
+#define KEY_MOD_CTRL    (1 << 17)
+#define KEY_MOD_ALT     (1 << 18)
+#define KEY_MOD_GUI     (1 << 19)
+#define KEY_MOD_CAPS    (1 << 20)
+
+/**
+ * @brief connect keyboard to stream, key and text words are never coalesced
+ *
+ * once attached, a key press no longer closes the window
+ */
+sc_bool attach_keyboard_generator(sc_queue * queue, sc_uint rate, sc_uint flags);
 
 void screen_pixel();
 void screen_fill();
 void screen_rect(sc_ushort w, sc_ushort h);
 void screen_move(sc_ushort x, sc_ushort y);
 void screen_colour(sc_uchar index);
-void screen_blit(sc_ushort x1, sc_ushort y1, sc_ushort x2, sc_ushort y2, sc_uchar *pixels);
-void screen_palette(void);
+
+/**
+ * @brief set framebuffer, for screen_blit
+ *
+ * pixels are 32-bit ARGB, row major, and are read by screen_blit, i.e. they 
+ * must remain valid until the framebuffer is changed
+ *
+ * @param width * height pixels
+ * @param width in pixels
+ * @param height in pixels
+ */
+void screen_framebuffer(sc_uint * pixels, sc_ushort width, sc_ushort height);
+
+/**
+ * @brief set 8-bit indexed framebuffer, for screen_blit
+ *
+ * as screen_framebuffer, but each pixel is a palette index, blitted 
+ * rectangles are expanded with the palette at present, so palette changes
+ * apply without redrawing
+ */
+void screen_framebuffer_indexed(sc_uchar * indices, sc_ushort width, sc_ushort height);
+
+/**
+ * @brief draw a rectangle of the framebuffer at the same position on screen
+ *
+ * only the rectangle is copied into the frame, and only it is uploaded when
+ * the frame is rendered
+ */
+void screen_blit(sc_ushort x, sc_ushort y, sc_ushort w, sc_ushort h);
+
+/**
+ * @brief set palette entries 0 to count-1, at most 256
+ *
+ * entries are 32-bit ARGB, the palette is used for colour indices and to 
+ * expand indexed framebuffers when they are presented
+ */
+void screen_palette(const sc_uint * entries, sc_uint count);
 void screen_resize(sc_ushort width, sc_ushort height, sc_int scale);
+
+/**
+ * @brief draw the whole of the next frame, even in retained mode
+ */
 void screen_redraw(void);
+
+/**
+ * @brief enable or disable retained mode
+ *
+ * in retained mode each frame's draw commands are compared with the last 
+ * presented frame and only the area that changed is redrawn, frames with no 
+ * changes are not presented
+ */
+void screen_retain(sc_bool enable);
+
+/**
+ * @brief load font into slot, 0 to 8, for screen_text
+ *
+ * returns immediately, the font is read and rasterized on the asset loader's
+ * thread and uploaded by the render thread, see screen_font_status. Text 
+ * drawn before then is not shown. The current colour is the font's colour.
+ *
+ * @param slot
+ * @param path of TTF, copied
+ * @param point size
+ */
 void screen_font(sc_ushort index, const sc_char * path, sc_ushort point);
+
+/**
+ * @brief load image into slot, 0 to 15, for screen_draw_image
+ *
+ * returns immediately, as screen_font, any format SDL_image supports
+ *
+ * @param slot
+ * @param path of image, copied
+ */
+void screen_image(sc_ushort index, const sc_char * path);
+
+/**
+ * @brief draw image slot at its own size, at the current position
+ *
+ * nothing is drawn if the slot is not loaded
+ */
+void screen_draw_image(sc_ushort index);
+
+/**
+ * @brief get status of font or image slot
+ *
+ * @return ASSET_LOADING while any load into the slot is still in flight, 
+ * otherwise the result of the last load, or ASSET_EMPTY if there was none
+ */
+sc_uint screen_font_status(sc_ushort index);
+sc_uint screen_image_status(sc_ushort index);
+
+/**
+ * @brief true while any font or image load is in flight
+ */
+sc_bool screen_loading();
+
+/**
+ * @brief set glyph atlases baked into the ROM by scasm, see @font
+ *
+ * a font loaded with screen_font, whose path and point size match an atlas, 
+ * is created from the atlas rather than rasterized from the TTF. Must be 
+ * called before screen_run(), atlases must remain valid until the screen is 
+ * deleted
+ */
+void screen_font_atlases(const font_atlas * atlases, sc_uint count);
 void screen_text(sc_ushort index, const sc_char * str);
 
 /**
@@ -0,0 +1,99 @@
+/* This file is part of {{ samplecontrol }}.
+ *
+ * 2024 Benedict R. Gaster (cuberoo_)
+ *
+ * Licensed under either of
+ * Apache License, Version 2.0 (LICENSE-APACHE or http://www.apache.org/licenses/LICENSE-2.0)
+ * MIT license (LICENSE-MIT or http://opensource.org/licenses/MIT)
+ * at your option.
+ */
+#ifndef TELEMETRY_HEADER_H
+#define TELEMETRY_HEADER_H
+
+#include <util.h>
+
+#define TELEMETRY_MAX_TASKS 16
+
+// wake-up jitter histogram buckets, upper bound of each bucket in microseconds,
+// the last bucket holds everything above
+#define TELEMETRY_JITTER_BUCKETS 9
+#define TELEMETRY_JITTER_BOUNDS_US { 10, 50, 100, 250, 500, 1000, 2000, 5000 }
+
+// values marked window are reset each time telemetry is published
+typedef struct {
+    sc_uint task_id_;
+    sc_uint rate_;
+    unsigned long long budget_ns_;          // 1s / rate, 0 if task runs as fast as possible
+    unsigned long long periods_;
+    unsigned long long overruns_;           // periods where cpu time exceeded budget
+    unsigned long long deadline_misses_;    // YIELDs that arrived after the period had ended
+    unsigned long long cpu_ns_last_;
+    unsigned long long cpu_ns_max_;         // window
+    unsigned long long cpu_ns_total_;
+    unsigned long long instructions_last_;
+    unsigned long long instructions_max_;   // window
+    unsigned long long instructions_total_;
+    long long jitter_ns_last_;
+    long long jitter_ns_max_;               // window
+    unsigned long long jitter_histogram_[TELEMETRY_JITTER_BUCKETS];
+} telemetry_task_stats;
+
+/**
+ * @brief enable telemetry
+ *
+ * stats for each task are written as one JSON object per line, every interval,
+ * to target, which is either a file path or unix:path for a local UNIX datagram
+ * socket. Stats are written out by a background thread, so writes never block
+ * the VM, if no one is listening on the socket then the stats are dropped.
+ *
+ * @param file path or unix:path
+ * @param interval between writes in milliseconds
+ * @return true if telemetry is enabled, otherwise false
+ */
+sc_bool enable_telemetry(const sc_char * target, sc_uint interval_ms);
+
+/**
+ * @brief register task with telemetry
+ */
+void telemetry_task(sc_uint task_id, sc_uint rate);
+
+/**
+ * @brief record end of a task's period, called at YIELD
+ *
+ * @param task
+ * @param time task spent executing since it last woke up
+ * @param instructions retired since it last woke up
+ * @param true if YIELD arrived after the period had already ended
+ */
+void telemetry_period(sc_uint task_id, unsigned long long cpu_ns,
+                      unsigned long long instructions, sc_bool missed_deadline);
+
+/**
+ * @brief record how late a task woke up compared to its deadline
+ */
+void telemetry_wakeup(sc_uint task_id, long long jitter_ns);
+
+/**
+ * @brief queue stats for writing, if interval has passed since last write
+ *
+ * @param current time in nanoseconds (CLOCK_MONOTONIC)
+ */
+void telemetry_publish(unsigned long long now_ns);
+
+/**
+ * @brief get stats for task
+ *
+ * @param task
+ * @param non null pointer to where stats will be returned
+ * @return true if task has stats, otherwise false
+ */
+sc_bool telemetry_stats(sc_uint task_id, telemetry_task_stats * dst);
+
+/**
+ * @brief write final stats and close target
+ *
+ * called automatically at exit, once telemetry is enabled
+ */
+void delete_telemetry();
+
+#endif // TELEMETRY_HEADER_H
@@ -0,0 +1,81 @@
+/* This file is part of {{ samplecontrol }}.
+ *
+ * 2024 Benedict R. Gaster (cuberoo_)
+ *
+ * Licensed under either of
+ * Apache License, Version 2.0 (LICENSE-APACHE or http://www.apache.org/licenses/LICENSE-2.0)
+ * MIT license (LICENSE-MIT or http://opensource.org/licenses/MIT)
+ * at your option.
+ */
+#ifndef TEXT_CACHE_HEADER_H
+#define TEXT_CACHE_HEADER_H
+
+#include <util.h>
+#include <SDL2/SDL.h>
+#include "SDL_FontCache.h"
+
+// glyphs of a run that are in the same glyph cache texture
+typedef struct {
+    sc_int cache_level_;
+    sc_uint first_;         // first quad
+    sc_uint count_;
+} text_run_level;
+
+// text laid out once, drawn as textured quads relative to its origin
+typedef struct {
+    sc_ushort font_;
+    sc_uint hash_;
+    sc_char * text_;        // NULL if entry is unused
+    SDL_Vertex * vertices_; // 4 per quad, sorted by cache level
+    sc_uint quads_;
+    text_run_level * levels_;
+    sc_uint level_count_;
+    sc_int w_;              // extent from the origin, for damage
+    sc_int h_;
+} text_run;
+
+typedef struct {
+    text_run * runs_;
+    sc_uint size_;
+    unsigned long long hits_;
+    unsigned long long misses_;
+
+    // per draw, vertices moved to the draw position and indices shared by all runs
+    SDL_Vertex * scratch_;
+    sc_uint scratch_capacity_;  // quads
+    sc_int * indices_;
+    sc_uint indices_capacity_;  // quads
+} text_cache;
+
+/**
+ * @brief allocate cache for text runs
+ *
+ * the cache is direct mapped, a run replaces any other that hashes to the same
+ * entry
+ *
+ * @param number of runs, a power of 2
+ */
+text_cache * allocate_text_cache(sc_uint size);
+void delete_text_cache(text_cache * cache);
+
+/**
+ * @brief get run for text in font, laying it out if it is not already cached
+ *
+ * @return run, or NULL if font is not loaded
+ */
+const text_run * text_cache_get(text_cache * cache, sc_ushort font_index, FC_Font * font, const sc_char * text);
+
+/**
+ * @brief drop runs for font, e.g. when it is reloaded, or for all fonts if index is -1
+ */
+void text_cache_invalidate(text_cache * cache, sc_int font_index);
+
+/**
+ * @brief draw run at x, y, one draw call per glyph cache texture
+ *
+ * @return number of draw calls
+ */
+sc_uint text_cache_draw(text_cache * cache, SDL_Renderer * renderer, FC_Font * font,
+                        const text_run * run, sc_short x, sc_short y);
+
+#endif // TEXT_CACHE_HEADER_H
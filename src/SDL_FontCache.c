@@ -278,143 +278,137 @@ FC_GlyphData FC_MakeGlyphData(int cache_level, Sint16 x, Sint16 y, Uint16 w, Uin
     return gd;
 }
 
-// Enough to hold all of the ascii characters and some.
-#define FC_DEFAULT_NUM_BUCKETS 300
+// Glyphs for codepoints below FC_MAP_DIRECT_SIZE (ASCII and Latin-1) are indexed directly, any others are
+// kept in an open addressing table (linear probing) that follows them in the same allocation.
+#define FC_MAP_DIRECT_SIZE 256
+#define FC_DEFAULT_TABLE_SIZE 64  // Must be a power of 2
+#define FC_MAP_EMPTY 0xFFFFFFFF   // Not a valid codepoint
 
-typedef struct FC_MapNode
+typedef struct FC_MapEntry
 {
     Uint32 key;
     FC_GlyphData value;
-    struct FC_MapNode* next;
 
-} FC_MapNode;
+} FC_MapEntry;
 
 typedef struct FC_Map
 {
-    int num_buckets;
-    FC_MapNode** buckets;
+    int table_size;
+    int table_bits;        // log2(table_size)
+    int table_count;
+    FC_MapEntry* entries;  // FC_MAP_DIRECT_SIZE direct entries, then table_size table entries
 } FC_Map;
 
 
+static_inline Uint32 FC_MapHash(Uint32 codepoint, int table_bits)
+{
+    // Fibonacci hashing, the top bits of the product depend on every bit of the codepoint,
+    // so nearby codepoints spread across the table
+    return (codepoint * 2654435761u) >> (32 - table_bits);
+}
 
-static FC_Map* FC_MapCreate(int num_buckets)
+static FC_MapEntry* FC_MapAllocEntries(int table_size)
 {
     int i;
-    FC_Map* map = (FC_Map*)malloc(sizeof(FC_Map));
+    int size = FC_MAP_DIRECT_SIZE + table_size;
+    FC_MapEntry* entries = (FC_MapEntry*)malloc(size * sizeof(FC_MapEntry));
 
-    map->num_buckets = num_buckets;
-    map->buckets = (FC_MapNode**)malloc(num_buckets * sizeof(FC_MapNode*));
-
-    for(i = 0; i < num_buckets; ++i)
+    for(i = 0; i < size; ++i)
     {
-        map->buckets[i] = NULL;
+        entries[i].key = FC_MAP_EMPTY;
     }
 
+    return entries;
+}
+
+static FC_Map* FC_MapCreate(int table_size)
+{
+    FC_Map* map = (FC_Map*)malloc(sizeof(FC_Map));
+
+    map->table_size = table_size;
+    map->table_bits = 0;
+    while((1 << map->table_bits) < table_size)
+        ++map->table_bits;
+    map->table_count = 0;
+    map->entries = FC_MapAllocEntries(table_size);
+
     return map;
 }
 
-/*static void FC_MapClear(FC_Map* map)
+static void FC_MapFree(FC_Map* map)
 {
-    int i;
     if(map == NULL)
         return;
 
-    // Go through each bucket
-    for(i = 0; i < map->num_buckets; ++i)
-    {
-        // Delete the nodes in order
-        FC_MapNode* node = map->buckets[i];
-        while(node != NULL)
-        {
-            FC_MapNode* last = node;
-            node = node->next;
-            free(last);
-        }
-        // Set the bucket to empty
-        map->buckets[i] = NULL;
-    }
-}*/
+    free(map->entries);
+    free(map);
+}
 
-static void FC_MapFree(FC_Map* map)
+// Entry for codepoint, either the one holding it or the empty one where it would go
+static_inline FC_MapEntry* FC_MapSlot(FC_MapEntry* entries, int table_bits, Uint32 codepoint)
+{
+    FC_MapEntry* table = entries + FC_MAP_DIRECT_SIZE;
+    Uint32 mask = (1u << table_bits) - 1;
+    Uint32 index = FC_MapHash(codepoint, table_bits);
+
+    if(codepoint < FC_MAP_DIRECT_SIZE)
+        return &entries[codepoint];
+
+    while(table[index].key != FC_MAP_EMPTY && table[index].key != codepoint)
+        index = (index + 1) & mask;
+
+    return &table[index];
+}
+
+static void FC_MapGrow(FC_Map* map)
 {
     int i;
-    if(map == NULL)
-        return;
+    int table_size = map->table_size * 2;
+    int table_bits = map->table_bits + 1;
+    FC_MapEntry* entries = FC_MapAllocEntries(table_size);
+    FC_MapEntry* old_table = map->entries + FC_MAP_DIRECT_SIZE;
 
-    // Go through each bucket
-    for(i = 0; i < map->num_buckets; ++i)
+    memcpy(entries, map->entries, FC_MAP_DIRECT_SIZE * sizeof(FC_MapEntry));
+    for(i = 0; i < map->table_size; ++i)
     {
-        // Delete the nodes in order
-        FC_MapNode* node = map->buckets[i];
-        while(node != NULL)
-        {
-            FC_MapNode* last = node;
-            node = node->next;
-            free(last);
-        }
+        if(old_table[i].key != FC_MAP_EMPTY)
+            *FC_MapSlot(entries, table_bits, old_table[i].key) = old_table[i];
     }
 
-    free(map->buckets);
-    free(map);
+    free(map->entries);
+    map->entries = entries;
+    map->table_size = table_size;
+    map->table_bits = table_bits;
 }
 
-// Note: Does not handle duplicates in any special way.
+// Note: Replaces any existing glyph for codepoint.  The returned pointer is valid until the next insert.
 static FC_GlyphData* FC_MapInsert(FC_Map* map, Uint32 codepoint, FC_GlyphData glyph)
 {
-    Uint32 index;
-    FC_MapNode* node;
+    FC_MapEntry* entry;
     if(map == NULL)
         return NULL;
 
-    // Get index for bucket
-    index = codepoint % map->num_buckets;
-
-    // If this bucket is empty, create a node and return its value
-    if(map->buckets[index] == NULL)
-    {
-        node = map->buckets[index] = (FC_MapNode*)malloc(sizeof(FC_MapNode));
-        node->key = codepoint;
-        node->value = glyph;
-        node->next = NULL;
-        return &node->value;
-    }
-
-    for(node = map->buckets[index]; node != NULL; node = node->next)
-    {
-        // Find empty node and add a new one on.
-        if(node->next == NULL)
-        {
-            node->next = (FC_MapNode*)malloc(sizeof(FC_MapNode));
-            node = node->next;
+    // Keep the table at most 3/4 full, so probes stay short
+    if(codepoint >= FC_MAP_DIRECT_SIZE && (map->table_count + 1) * 4 > map->table_size * 3)
+        FC_MapGrow(map);
 
-            node->key = codepoint;
-            node->value = glyph;
-            node->next = NULL;
-            return &node->value;
-        }
-    }
+    entry = FC_MapSlot(map->entries, map->table_bits, codepoint);
+    if(entry->key == FC_MAP_EMPTY && codepoint >= FC_MAP_DIRECT_SIZE)
+        map->table_count++;
 
-    return NULL;
+    entry->key = codepoint;
+    entry->value = glyph;
+    return &entry->value;
 }
 
 static FC_GlyphData* FC_MapFind(FC_Map* map, Uint32 codepoint)
 {
-    Uint32 index;
-    FC_MapNode* node;
+    FC_MapEntry* entry;
     if(map == NULL)
         return NULL;
 
-    // Get index for bucket
-    index = codepoint % map->num_buckets;
-
-    // Go through list until we find a match
-    for(node = map->buckets[index]; node != NULL; node = node->next)
-    {
-        if(node->key == codepoint)
-            return &node->value;
-    }
-
-    return NULL;
+    entry = FC_MapSlot(map->entries, map->table_bits, codepoint);
+    return entry->key == codepoint? &entry->value : NULL;
 }
 
 
@@ -889,7 +883,7 @@ static void FC_Init(FC_Font* font)
     if(font->glyphs != NULL)
         FC_MapFree(font->glyphs);
 
-    font->glyphs = FC_MapCreate(FC_DEFAULT_NUM_BUCKETS);
+    font->glyphs = FC_MapCreate(FC_DEFAULT_TABLE_SIZE);
 
     font->glyph_cache_size = 3;
     font->glyph_cache_count = 0;
@@ -1291,6 +1285,62 @@ Uint8 FC_LoadFontFromTTF(FC_Font* font, SDL_Renderer* renderer, TTF_Font* ttf, S
     return 1;
 }
 
+#ifdef FC_USE_SDL_GPU
+Uint8 FC_LoadFontFromAtlas(FC_Font* font, SDL_Surface* atlas, TTF_Font* ttf, int height, int ascent, int descent, SDL_Color color)
+#else
+Uint8 FC_LoadFontFromAtlas(FC_Font* font, SDL_Renderer* renderer, SDL_Surface* atlas, TTF_Font* ttf, int height, int ascent, int descent, SDL_Color color)
+#endif
+{
+    if(font == NULL || atlas == NULL)
+        return 0;
+    #ifndef FC_USE_SDL_GPU
+    if(renderer == NULL)
+        return 0;
+    #endif
+
+    FC_ClearFont(font);
+
+    #ifdef FC_USE_SDL_GPU
+    fc_has_render_target_support = GPU_IsFeatureEnabled(GPU_FEATURE_RENDER_TARGETS);
+    #else
+    SDL_RendererInfo info;
+    SDL_GetRendererInfo(renderer, &info);
+    fc_has_render_target_support = (info.flags & SDL_RENDERER_TARGETTEXTURE);
+
+    font->renderer = renderer;
+    #endif
+
+    // Same metrics as FC_LoadFontFromTTF, glyphs missing from the atlas are rendered from ttf, if any
+    font->ttf_source = ttf;
+    font->owns_ttf_source = (ttf != NULL);
+
+    font->height = height;
+    font->ascent = ascent;
+    font->descent = -descent;
+
+    if(font->height < font->ascent - font->descent)
+        font->height = font->ascent - font->descent;
+
+    font->baseline = font->height - font->descent;
+
+    font->default_color = color;
+
+    if(!FC_UploadGlyphCache(font, 0, atlas))
+        return 0;
+    #ifndef FC_USE_SDL_GPU
+    SDL_SetTextureBlendMode(font->glyph_cache[0], SDL_BLENDMODE_BLEND);
+    #endif
+
+    // The atlas is full, so glyphs rendered later go on a new cache level
+    font->last_glyph.cache_level = 0;
+    font->last_glyph.rect.x = atlas->w;
+    font->last_glyph.rect.y = atlas->h;
+    font->last_glyph.rect.w = 0;
+    font->last_glyph.rect.h = font->height;
+
+    return 1;
+}
+
 
 #ifdef FC_USE_SDL_GPU
 Uint8 FC_LoadFont(FC_Font* font, const char* filename_ttf, Uint32 pointSize, SDL_Color color, int style)
@@ -1569,13 +1619,10 @@ unsigned int FC_GetNumCodepoints(FC_Font* font)
 
     glyphs = font->glyphs;
 
-    for(i = 0; i < glyphs->num_buckets; ++i)
+    for(i = 0; i < FC_MAP_DIRECT_SIZE + glyphs->table_size; ++i)
     {
-        FC_MapNode* node;
-        for(node = glyphs->buckets[i]; node != NULL; node = node->next)
-        {
+        if(glyphs->entries[i].key != FC_MAP_EMPTY)
             result++;
-        }
     }
 
     return result;
@@ -1591,12 +1638,11 @@ void FC_GetCodepoints(FC_Font* font, Uint32* result)
 
     glyphs = font->glyphs;
 
-    for(i = 0; i < glyphs->num_buckets; ++i)
+    for(i = 0; i < FC_MAP_DIRECT_SIZE + glyphs->table_size; ++i)
     {
-        FC_MapNode* node;
-        for(node = glyphs->buckets[i]; node != NULL; node = node->next)
+        if(glyphs->entries[i].key != FC_MAP_EMPTY)
         {
-            result[count] = node->key;
+            result[count] = glyphs->entries[i].key;
             count++;
         }
     }
@@ -1775,6 +1821,78 @@ FC_Rect FC_Draw(FC_Font* font, FC_Target* dest, float x, float y, const char* fo
 }
 
 
+FC_Rect FC_DrawText(FC_Font* font, FC_Target* dest, float x, float y, const char* text)
+{
+    if(text == NULL || font == NULL)
+        return FC_MakeRect(x, y, 0, 0);
+
+    set_color_for_all_caches(font, font->default_color);
+
+    return FC_RenderLeft(font, dest, x, y, FC_MakeScale(1,1), text);
+}
+
+// Same layout as FC_RenderLeft(), at scale 1, without drawing
+int FC_GetGlyphQuads(FC_Font* font, const char* text, FC_GlyphQuad* result, int max_quads, FC_Rect* bounds)
+{
+    const char* c = text;
+    FC_GlyphData glyph;
+    Uint32 codepoint;
+    int count = 0;
+    float destX = 0;
+    float destY = 0;
+
+    if(bounds != NULL)
+        *bounds = FC_MakeRect(0, 0, 0, 0);
+
+    if(font == NULL || c == NULL || font->glyph_cache_count == 0)
+        return 0;
+
+    for(; *c != '\0'; c++)
+    {
+        if(*c == '\n')
+        {
+            destX = 0;
+            destY += font->height + font->lineSpacing;
+            continue;
+        }
+
+        codepoint = FC_GetCodepointFromUTF8(&c, 1);  // Increments 'c' to skip the extra UTF-8 bytes
+        if(!FC_GetGlyphData(font, &glyph, codepoint))
+        {
+            codepoint = ' ';
+            if(!FC_GetGlyphData(font, &glyph, codepoint))
+                continue;  // Skip bad characters
+        }
+
+        if (codepoint != ' ')
+        {
+            FC_Rect dst = FC_MakeRect((int)destX, (int)destY, glyph.rect.w, glyph.rect.h);
+            if(count < max_quads)
+            {
+                #ifdef FC_USE_SDL_GPU
+                result[count].src = FC_MakeRect(glyph.rect.x, glyph.rect.y, glyph.rect.w, glyph.rect.h);
+                #else
+                result[count].src = glyph.rect;
+                #endif
+                result[count].dst = dst;
+                result[count].cache_level = glyph.cache_level;
+            }
+            if(bounds != NULL)
+            {
+                if(count == 0)
+                    *bounds = dst;
+                else
+                    *bounds = FC_RectUnion(*bounds, dst);
+            }
+            count++;
+        }
+
+        destX += glyph.rect.w + font->letterSpacing;
+    }
+
+    return count;
+}
+
 
 typedef struct FC_StringList
 {
@@ -0,0 +1,225 @@
+/* This file is part of {{ samplecontrol }}.
+ *
+ * 2024 Benedict R. Gaster (cuberoo_)
+ *
+ * Licensed under either of
+ * Apache License, Version 2.0 (LICENSE-APACHE or http://www.apache.org/licenses/LICENSE-2.0)
+ * MIT license (LICENSE-MIT or http://opensource.org/licenses/MIT)
+ * at your option.
+ */
+
+#include <asset_loader.h>
+
+#include <SDL2/SDL_image.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+//-----------------------------------------------------------------------------------------------
+// Globals
+//-----------------------------------------------------------------------------------------------
+
+#define MAX_JOBS 32
+
+// one ring, jobs move from tail to decoded to head
+static asset_job jobs[MAX_JOBS];
+static atomic_uint jobs_tail = 0;       // next free, VM thread
+static atomic_uint jobs_decoded = 0;    // next to decode, worker thread
+static atomic_uint jobs_head = 0;       // next to upload, render thread
+
+static pthread_t worker;
+static sc_bool running = FALSE;
+static sc_bool stopping = FALSE;
+static pthread_mutex_t worker_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t worker_wake = PTHREAD_COND_INITIALIZER;
+
+static pthread_mutex_t fonts_lock = PTHREAD_MUTEX_INITIALIZER;
+
+//-----------------------------------------------------------------------------------------------
+// worker thread
+//-----------------------------------------------------------------------------------------------
+
+SDL_Surface * font_atlas_surface(const font_atlas * atlas) {
+    SDL_Surface * surface = SDL_CreateRGBSurfaceWithFormat(
+        0, atlas->width_, atlas->rows_, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (surface == NULL) {
+        return NULL;
+    }
+    SDL_LockSurface(surface);
+    for (sc_int y = 0; y < atlas->rows_; y++) {
+        sc_uint * dst = (sc_uint*)((sc_uchar*)surface->pixels + y * surface->pitch);
+        const sc_uchar * src = &atlas->coverage_[y * atlas->width_];
+        for (sc_int x = 0; x < atlas->width_; x++) {
+            dst[x] = 0x00FFFFFF | ((sc_uint)src[x] << 24);
+        }
+    }
+    SDL_UnlockSurface(surface);
+    return surface;
+}
+
+static void decode_font(asset_job * job) {
+    if (job->rom_atlas_ >= 0) {
+        // already rasterized by scasm
+        job->ok_ = TRUE;
+        return;
+    }
+
+    lock_fonts();
+    job->ttf_ = TTF_OpenFont(job->path_, job->point_);
+    unlock_fonts();
+    if (job->ttf_ == NULL) {
+        sc_error("ERROR: could not open font %s\n", job->path_);
+        return;
+    }
+
+    // rasterize the same glyphs scasm would bake, so upload is all that is left
+    if (!bake_font_atlas_from_ttf(job->ttf_, job->path_, job->point_, &job->atlas_)) {
+        return;
+    }
+    job->surface_ = font_atlas_surface(&job->atlas_);
+    job->ok_ = job->surface_ != NULL;
+}
+
+static void decode_image(asset_job * job) {
+    SDL_Surface * image = IMG_Load(job->path_);
+    if (image == NULL) {
+        sc_error("ERROR: could not load image %s\n", job->path_);
+        return;
+    }
+    job->surface_ = SDL_ConvertSurfaceFormat(image, SDL_PIXELFORMAT_ARGB8888, 0);
+    SDL_FreeSurface(image);
+    job->ok_ = job->surface_ != NULL;
+}
+
+static void * worker_thread(void * unused) {
+    sc_uint decoded = atomic_load_explicit(&jobs_decoded, memory_order_relaxed);
+    for (;;) {
+        pthread_mutex_lock(&worker_lock);
+        while (!stopping && decoded == atomic_load_explicit(&jobs_tail, memory_order_acquire)) {
+            pthread_cond_wait(&worker_wake, &worker_lock);
+        }
+        sc_bool stop = stopping;
+        pthread_mutex_unlock(&worker_lock);
+        if (stop) {
+            break;
+        }
+
+        asset_job * job = &jobs[decoded % MAX_JOBS];
+        if (job->kind_ == ASSET_FONT) {
+            decode_font(job);
+        }
+        else {
+            decode_image(job);
+        }
+        decoded++;
+        atomic_store_explicit(&jobs_decoded, decoded, memory_order_release);
+    }
+    return NULL;
+}
+
+//-----------------------------------------------------------------------------------------------
+//-----------------------------------------------------------------------------------------------
+
+sc_bool init_asset_loader() {
+    // both initialize global state, so do it before the worker starts
+    if (!TTF_WasInit() && TTF_Init() != 0) {
+        sc_error("ERROR: could not initialize SDL_ttf\n");
+        return FALSE;
+    }
+    IMG_Init(IMG_INIT_PNG | IMG_INIT_JPG);
+
+    stopping = FALSE;
+    if (pthread_create(&worker, NULL, worker_thread, NULL) != 0) {
+        sc_error("ERROR: could not create asset loader thread\n");
+        return FALSE;
+    }
+    running = TRUE;
+    return TRUE;
+}
+
+static void free_job(asset_job * job) {
+    SDL_FreeSurface(job->surface_);
+    job->surface_ = NULL;
+    free(job->atlas_.glyphs_);
+    free(job->atlas_.coverage_);
+    job->atlas_.glyphs_ = NULL;
+    job->atlas_.coverage_ = NULL;
+    if (job->ttf_) {
+        lock_fonts();
+        TTF_CloseFont(job->ttf_);
+        unlock_fonts();
+        job->ttf_ = NULL;
+    }
+}
+
+void delete_asset_loader() {
+    if (!running) {
+        return;
+    }
+    pthread_mutex_lock(&worker_lock);
+    stopping = TRUE;
+    pthread_cond_signal(&worker_wake);
+    pthread_mutex_unlock(&worker_lock);
+    pthread_join(worker, NULL);
+    running = FALSE;
+
+    // decoded but never uploaded
+    sc_uint head = atomic_load(&jobs_head);
+    sc_uint decoded = atomic_load(&jobs_decoded);
+    for (; head != decoded; head++) {
+        free_job(&jobs[head % MAX_JOBS]);
+    }
+    atomic_store(&jobs_head, 0);
+    atomic_store(&jobs_decoded, 0);
+    atomic_store(&jobs_tail, 0);
+}
+
+void asset_loader_push(const asset_job * job) {
+    sc_uint tail = atomic_load_explicit(&jobs_tail, memory_order_relaxed);
+    while (tail - atomic_load_explicit(&jobs_head, memory_order_acquire) >= MAX_JOBS) {
+        struct timespec t = { 0, 100000 };
+        nanosleep(&t, NULL);
+    }
+
+    asset_job * dst = &jobs[tail % MAX_JOBS];
+    memset(dst, 0, sizeof(asset_job));
+    dst->kind_ = job->kind_;
+    dst->index_ = job->index_;
+    dst->point_ = job->point_;
+    dst->colour_ = job->colour_;
+    dst->rom_atlas_ = job->rom_atlas_;
+    mcopy(job->path_, dst->path_, sizeof(dst->path_));
+
+    pthread_mutex_lock(&worker_lock);
+    atomic_store_explicit(&jobs_tail, tail + 1, memory_order_release);
+    pthread_cond_signal(&worker_wake);
+    pthread_mutex_unlock(&worker_lock);
+}
+
+asset_job * asset_loader_peek() {
+    sc_uint head = atomic_load_explicit(&jobs_head, memory_order_relaxed);
+    if (head == atomic_load_explicit(&jobs_decoded, memory_order_acquire)) {
+        return NULL;
+    }
+    return &jobs[head % MAX_JOBS];
+}
+
+void asset_loader_pop() {
+    sc_uint head = atomic_load_explicit(&jobs_head, memory_order_relaxed);
+    free_job(&jobs[head % MAX_JOBS]);
+    atomic_store_explicit(&jobs_head, head + 1, memory_order_release);
+}
+
+sc_bool asset_loader_busy() {
+    return atomic_load_explicit(&jobs_head, memory_order_acquire) !=
+           atomic_load_explicit(&jobs_tail, memory_order_acquire);
+}
+
+void lock_fonts() {
+    pthread_mutex_lock(&fonts_lock);
+}
+
+void unlock_fonts() {
+    pthread_mutex_unlock(&fonts_lock);
+}
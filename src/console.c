@@ -1,18 +1,213 @@
 #include <console.h>
+#include <generator.h>
+
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+// bytes written by the VM thread are copied into a ring, which a writer thread 
+// drains to stdout, so the VM never waits for the terminal
+#define CONSOLE_BUFFER_SIZE (1 << 16)
+
+static sc_char buffer[CONSOLE_BUFFER_SIZE];
+static atomic_uint buffer_head = 0;     // next to write out, writer thread
+static atomic_uint buffer_tail = 0;     // next free, VM thread
+
+static unsigned long long written = 0;
+static unsigned long long dropped = 0;  // ring was full
+
+static pthread_t writer;
+static sc_bool running = FALSE;
+static atomic_int stopping = FALSE;
+static atomic_int sleeping = FALSE;     // writer is waiting for bytes
+static pthread_mutex_t writer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t writer_wake = PTHREAD_COND_INITIALIZER;
+
+// stdin is read on its own thread, which may block, and sent to an attached stream
+#define CONSOLE_LINE_SIZE 1024
+
+static sc_generator input;
+static sc_uint input_mode = CONSOLE_INPUT_BYTES;
+static pthread_t reader;
+static sc_bool reading = FALSE;
 
 sc_bool has_console_device() {
     return TRUE;
 }
 
+// write out everything up to tail, in at most two pieces as the ring wraps
+static void drain() {
+    sc_uint head = atomic_load_explicit(&buffer_head, memory_order_relaxed);
+    sc_uint tail = atomic_load_explicit(&buffer_tail, memory_order_acquire);
+    while (head != tail) {
+        sc_uint offset = head % CONSOLE_BUFFER_SIZE;
+        sc_uint count = tail - head;
+        if (count > CONSOLE_BUFFER_SIZE - offset) {
+            count = CONSOLE_BUFFER_SIZE - offset;
+        }
+        fwrite(&buffer[offset], 1, count, stdout);
+        head += count;
+        atomic_store_explicit(&buffer_head, head, memory_order_release);
+    }
+    fflush(stdout);
+}
+
+static void * writer_thread(void * unused) {
+    for (;;) {
+        drain();
+
+        pthread_mutex_lock(&writer_lock);
+        atomic_store(&sleeping, TRUE);
+        // check again, as bytes added before sleeping was set would not wake us
+        while (!atomic_load(&stopping) && 
+               atomic_load(&buffer_head) == atomic_load(&buffer_tail)) {
+            pthread_cond_wait(&writer_wake, &writer_lock);
+        }
+        atomic_store(&sleeping, FALSE);
+        pthread_mutex_unlock(&writer_lock);
+
+        if (atomic_load(&stopping)) {
+            drain();
+            break;
+        }
+    }
+    return NULL;
+}
+
 sc_bool init_console() {
+    atomic_store(&stopping, FALSE);
+    if (pthread_create(&writer, NULL, writer_thread, NULL) != 0) {
+        sc_error("ERROR: could not create console thread\n");
+        return FALSE;
+    }
+    running = TRUE;
+    return TRUE;
+}
+
+sc_bool write_console_string(const sc_char * str, sc_uint length) {
+    if (!running) {
+        fwrite(str, 1, length, stdout);
+        return TRUE;
+    }
+
+    sc_uint tail = atomic_load_explicit(&buffer_tail, memory_order_relaxed);
+    sc_uint space = CONSOLE_BUFFER_SIZE - (tail - atomic_load_explicit(&buffer_head, memory_order_acquire));
+    if (length > space) {
+        // never wait for the terminal, lose what does not fit
+        dropped += length - space;
+        length = space;
+    }
+    sc_uint offset = tail % CONSOLE_BUFFER_SIZE;
+    sc_uint first = length < CONSOLE_BUFFER_SIZE - offset ? length : CONSOLE_BUFFER_SIZE - offset;
+    memcpy(&buffer[offset], str, first);
+    memcpy(buffer, str + first, length - first);
+    // seq_cst, as the writer stores sleeping then loads the tail, so the load of
+    // sleeping below must not be seen before this store or the wake up is missed
+    atomic_store_explicit(&buffer_tail, tail + length, memory_order_seq_cst);
+    written += length;
+
+    // only pay for a wake up when the writer has nothing to do
+    if (atomic_load(&sleeping)) {
+        pthread_mutex_lock(&writer_lock);
+        pthread_cond_signal(&writer_wake);
+        pthread_mutex_unlock(&writer_lock);
+    }
     return TRUE;
 }
 
 sc_bool write_console(sc_char ch) {
-    putc(ch, stdout);
+    return write_console_string(&ch, 1);
+}
+
+sc_bool write_console_int(sc_int value) {
+    sc_char digits[16];
+    sc_int length = snprintf(digits, sizeof(digits), "%d", value);
+    return write_console_string(digits, length);
+}
+
+sc_bool write_console_float(sc_float value) {
+    sc_char digits[32];
+    sc_int length = snprintf(digits, sizeof(digits), "%g", value);
+    return write_console_string(digits, length);
+}
+
+void console_stats(unsigned long long * bytes, unsigned long long * lost) {
+    *bytes = written;
+    *lost = dropped;
+}
+
+// unlike the mouse, input is not lost when the stream is full, the reader waits
+static void send_input(sc_uint value) {
+    sc_queue * queue = atomic_load_explicit(&input.queue_, memory_order_acquire);
+    while (!enqueue(queue, value)) {
+        struct timespec t = { 0, 1000000 };
+        nanosleep(&t, NULL);
+    }
+}
+
+static void * reader_thread(void * unused) {
+    sc_char line[CONSOLE_LINE_SIZE];
+    sc_uint length = 0;
+    for (;;) {
+        sc_char bytes[256];
+        ssize_t count = read(STDIN_FILENO, bytes, sizeof(bytes));
+        if (count <= 0) {
+            break;
+        }
+        for (ssize_t i = 0; i < count; i++) {
+            if (input_mode == CONSOLE_INPUT_BYTES) {
+                send_input((sc_uchar)bytes[i]);
+                continue;
+            }
+            // lines are sent whole, once complete or too long to hold
+            line[length++] = bytes[i];
+            if (bytes[i] == '\n' || length == CONSOLE_LINE_SIZE) {
+                for (sc_uint c = 0; c < length; c++) {
+                    send_input((sc_uchar)line[c]);
+                }
+                length = 0;
+            }
+        }
+    }
+    // last line may not end in a newline
+    for (sc_uint c = 0; c < length; c++) {
+        send_input((sc_uchar)line[c]);
+    }
+    send_input(CONSOLE_INPUT_EOF);
+    return NULL;
+}
+
+sc_bool attach_console_input_generator(sc_queue * queue, sc_uint mode) {
+    if (reading) {
+        sc_error("ERROR: console input already attached\n");
+        return FALSE;
+    }
+    input_mode = mode;
+    attach_generator(&input, queue, 0, 0);
+    if (pthread_create(&reader, NULL, reader_thread, NULL) != 0) {
+        sc_error("ERROR: could not create console input thread\n");
+        return FALSE;
+    }
+    // may be blocked in read() at exit, so it is never joined
+    pthread_detach(reader);
+    reading = TRUE;
     return TRUE;
 }
 
 sc_bool delete_console() {
-    return FALSE;
+    if (!running) {
+        return FALSE;
+    }
+    pthread_mutex_lock(&writer_lock);
+    atomic_store(&stopping, TRUE);
+    pthread_cond_signal(&writer_wake);
+    pthread_mutex_unlock(&writer_lock);
+    pthread_join(writer, NULL);
+    running = FALSE;
+    if (dropped > 0) {
+        sc_error("WARNING: console output full, %llu bytes lost\n", dropped);
+    }
+    return TRUE;
 }
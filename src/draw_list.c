@@ -0,0 +1,131 @@
+/* This file is part of {{ samplecontrol }}.
+ *
+ * 2024 Benedict R. Gaster (cuberoo_)
+ *
+ * Licensed under either of
+ * Apache License, Version 2.0 (LICENSE-APACHE or http://www.apache.org/licenses/LICENSE-2.0)
+ * MIT license (LICENSE-MIT or http://opensource.org/licenses/MIT)
+ * at your option.
+ */
+
+#include <draw_list.h>
+
+#include <string.h>
+
+#define INITIAL_COMMANDS 1024
+#define INITIAL_DATA 1024
+
+draw_list * allocate_draw_list() {
+    draw_list * list = (draw_list*)malloc(sizeof(draw_list));
+    list->commands_ = (draw_command*)malloc(INITIAL_COMMANDS * sizeof(draw_command));
+    list->count_ = 0;
+    list->capacity_ = INITIAL_COMMANDS;
+    list->data_ = (sc_uchar*)malloc(INITIAL_DATA);
+    list->data_length_ = 0;
+    list->data_capacity_ = INITIAL_DATA;
+    return list;
+}
+
+void delete_draw_list(draw_list * list) {
+    if (list) {
+        free(list->commands_);
+        free(list->data_);
+        free(list);
+    }
+}
+
+void draw_list_reset(draw_list * list) {
+    list->count_ = 0;
+    list->data_length_ = 0;
+}
+
+static draw_command * push(draw_list * list, sc_uchar kind, sc_uchar colour) {
+    if (list->count_ == list->capacity_) {
+        list->capacity_ *= 2;
+        list->commands_ = (draw_command*)realloc(list->commands_, list->capacity_ * sizeof(draw_command));
+    }
+    draw_command * command = &list->commands_[list->count_++];
+    command->kind_ = kind;
+    command->colour_ = colour;
+    return command;
+}
+
+// reserve length bytes, 4 byte aligned, in data and return offset
+static sc_uint push_data(draw_list * list, sc_uint length) {
+    sc_uint offset = (list->data_length_ + 3) & ~3u;
+    while (offset + length > list->data_capacity_) {
+        list->data_capacity_ *= 2;
+        list->data_ = (sc_uchar*)realloc(list->data_, list->data_capacity_);
+    }
+    list->data_length_ = offset + length;
+    return offset;
+}
+
+void draw_list_fill(draw_list * list, sc_uchar colour) {
+    draw_list_reset(list);
+    push(list, DRAW_FILL, colour);
+}
+
+void draw_list_pixel(draw_list * list, sc_uchar colour, sc_short x, sc_short y) {
+    draw_command * command = push(list, DRAW_PIXEL, colour);
+    command->x_ = x;
+    command->y_ = y;
+}
+
+void draw_list_rect(draw_list * list, sc_uchar colour, sc_short x, sc_short y, sc_ushort w, sc_ushort h) {
+    draw_command * command = push(list, DRAW_RECT, colour);
+    command->x_ = x;
+    command->y_ = y;
+    command->w_ = w;
+    command->h_ = h;
+}
+
+void draw_list_blit(draw_list * list, sc_uchar kind, sc_short x, sc_short y, sc_ushort w, sc_ushort h, 
+                    const void * pixels, sc_uint pitch) {
+    sc_uint row_length = kind == DRAW_BLIT_INDEXED ? w : w * sizeof(sc_uint);
+    sc_uint offset = push_data(list, row_length * h);
+    for (sc_uint row = 0; row < h; row++) {
+        memcpy(list->data_ + offset + row * row_length, (const sc_uchar*)pixels + row * pitch, row_length);
+    }
+
+    draw_command * command = push(list, kind, 0);
+    command->x_ = x;
+    command->y_ = y;
+    command->w_ = w;
+    command->h_ = h;
+    command->data_ = offset;
+}
+
+void draw_list_text(draw_list * list, sc_uchar colour, sc_ushort font, sc_short x, sc_short y, const sc_char * str) {
+    sc_uint length = slen(str) + 1;
+    sc_uint offset = push_data(list, length);
+    mcopy(str, (sc_char*)list->data_ + offset, length);
+
+    draw_command * command = push(list, DRAW_TEXT, colour);
+    command->font_ = font;
+    command->x_ = x;
+    command->y_ = y;
+    command->data_ = offset;
+}
+
+void draw_list_image(draw_list * list, sc_ushort image, sc_short x, sc_short y) {
+    draw_command * command = push(list, DRAW_IMAGE, 0);
+    command->font_ = image;
+    command->x_ = x;
+    command->y_ = y;
+}
+
+void draw_list_copy(draw_list * dst, const draw_list * src) {
+    if (dst->capacity_ < src->count_) {
+        dst->capacity_ = src->capacity_;
+        dst->commands_ = (draw_command*)realloc(dst->commands_, dst->capacity_ * sizeof(draw_command));
+    }
+    if (dst->data_capacity_ < src->data_length_) {
+        dst->data_capacity_ = src->data_capacity_;
+        dst->data_ = (sc_uchar*)realloc(dst->data_, dst->data_capacity_);
+    }
+    memcpy(dst->commands_, src->commands_, src->count_ * sizeof(draw_command));
+    memcpy(dst->data_, src->data_, src->data_length_);
+    dst->count_ = src->count_;
+    dst->data_length_ = src->data_length_;
+}
@@ -0,0 +1,213 @@
+/* This file is part of {{ samplecontrol }}.
+ *
+ * 2024 Benedict R. Gaster (cuberoo_)
+ *
+ * Licensed under either of
+ * Apache License, Version 2.0 (LICENSE-APACHE or http://www.apache.org/licenses/LICENSE-2.0)
+ * MIT license (LICENSE-MIT or http://opensource.org/licenses/MIT)
+ * at your option.
+ */
+
+#include <font_atlas.h>
+
+#include <SDL2/SDL.h>
+#include <string.h>
+
+#define MAX_ATLAS_WIDTH 2048
+
+// printable ASCII and Latin-1
+static sc_bool is_baked(sc_uint codepoint) {
+    return (codepoint >= 32 && codepoint <= 126) || (codepoint >= 160 && codepoint <= 255);
+}
+
+static void encode_utf8(sc_uint codepoint, sc_char * buffer) {
+    if (codepoint < 0x80) {
+        buffer[0] = codepoint;
+        buffer[1] = '\0';
+    }
+    else {
+        buffer[0] = 0xC0 | (codepoint >> 6);
+        buffer[1] = 0x80 | (codepoint & 0x3F);
+        buffer[2] = '\0';
+    }
+}
+
+sc_bool bake_font_atlas(const sc_char * path, sc_ushort point, font_atlas * atlas) {
+    if (!TTF_WasInit() && TTF_Init() != 0) {
+        sc_error("ERROR: could not initialize SDL_ttf\n");
+        return FALSE;
+    }
+    TTF_Font * ttf = TTF_OpenFont(path, point);
+    if (ttf == NULL) {
+        sc_error("ERROR: could not open font %s\n", path);
+        return FALSE;
+    }
+    sc_bool ok = bake_font_atlas_from_ttf(ttf, path, point, atlas);
+    TTF_CloseFont(ttf);
+    return ok;
+}
+
+sc_bool bake_font_atlas_from_ttf(TTF_Font * ttf, const sc_char * path, sc_ushort point, font_atlas * atlas) {
+    if (slen(path) >= FONT_ATLAS_MAX_PATH) {
+        sc_error("ERROR: font path too long %s\n", path);
+        return FALSE;
+    }
+
+    memset(atlas, 0, sizeof(font_atlas));
+    mcopy(path, atlas->path_, slen(path) + 1);
+    atlas->point_ = point;
+    atlas->height_ = TTF_FontHeight(ttf);
+    atlas->ascent_ = TTF_FontAscent(ttf);
+    atlas->descent_ = TTF_FontDescent(ttf);
+
+    // same shape SDL_FontCache uses for its first cache level, only as many rows as needed
+    sc_int width = atlas->height_ * 12;
+    atlas->width_ = width > MAX_ATLAS_WIDTH ? MAX_ATLAS_WIDTH : width;
+
+    SDL_Surface * surfaces[256] = { NULL };
+    atlas->glyphs_ = (font_atlas_glyph*)malloc(256 * sizeof(font_atlas_glyph));
+    SDL_Color white = { 255, 255, 255, 255 };
+    sc_int x = FONT_ATLAS_PADDING;
+    sc_int y = FONT_ATLAS_PADDING;
+
+    // pack glyphs in rows, as SDL_FontCache does
+    for (sc_uint codepoint = 0; codepoint < 256; codepoint++) {
+        if (!is_baked(codepoint)) {
+            continue;
+        }
+        sc_char buffer[4];
+        encode_utf8(codepoint, buffer);
+        SDL_Surface * surface = TTF_RenderUTF8_Blended(ttf, buffer, white);
+        if (surface == NULL) {
+            continue;
+        }
+        if (x + surface->w >= atlas->width_ - FONT_ATLAS_PADDING) {
+            x = FONT_ATLAS_PADDING;
+            y += atlas->height_ + FONT_ATLAS_PADDING;
+        }
+
+        font_atlas_glyph * glyph = &atlas->glyphs_[atlas->glyph_count_];
+        glyph->codepoint_ = codepoint;
+        glyph->x_ = x;
+        glyph->y_ = y;
+        glyph->w_ = surface->w;
+        glyph->h_ = atlas->height_;
+        surfaces[atlas->glyph_count_++] = surface;
+        x += surface->w + 1 + FONT_ATLAS_PADDING;
+    }
+
+    if (y + atlas->height_ + FONT_ATLAS_PADDING > 0xFFFF) {
+        sc_error("ERROR: font %s at %d point is too large to bake\n", path, point);
+        for (sc_uint i = 0; i < atlas->glyph_count_; i++) {
+            SDL_FreeSurface(surfaces[i]);
+        }
+        free(atlas->glyphs_);
+        return FALSE;
+    }
+    atlas->rows_ = y + atlas->height_ + FONT_ATLAS_PADDING;
+    atlas->coverage_ = (sc_uchar*)calloc(atlas->width_ * atlas->rows_, 1);
+
+    // blended glyphs are 32-bit ARGB, keep only alpha as the colour comes from the font
+    for (sc_uint i = 0; i < atlas->glyph_count_; i++) {
+        const font_atlas_glyph * glyph = &atlas->glyphs_[i];
+        SDL_Surface * surface = surfaces[i];
+        sc_int h = surface->h < glyph->h_ ? surface->h : glyph->h_;
+        SDL_LockSurface(surface);
+        for (sc_int row = 0; row < h; row++) {
+            const sc_uint * src = (const sc_uint*)((const sc_uchar*)surface->pixels + row * surface->pitch);
+            sc_uchar * dst = &atlas->coverage_[(glyph->y_ + row) * atlas->width_ + glyph->x_];
+            for (sc_int col = 0; col < glyph->w_; col++) {
+                dst[col] = src[col] >> 24;
+            }
+        }
+        SDL_UnlockSurface(surface);
+        SDL_FreeSurface(surface);
+    }
+
+    return TRUE;
+}
+
+//-----------------------------------------------------------------------------------------------
+// ROM section, magic, count, then for each atlas its path length and path, metrics,
+// glyphs, and coverage
+//-----------------------------------------------------------------------------------------------
+
+static sc_bool put(FILE * file, const void * data, size_t bytes) {
+    return fwrite(data, 1, bytes, file) == bytes;
+}
+
+static sc_bool get(FILE * file, void * data, size_t bytes) {
+    return fread(data, 1, bytes, file) == bytes;
+}
+
+sc_bool write_font_atlases(FILE * file, const font_atlas * atlases, sc_uint count) {
+    sc_uint magic = FONT_ATLAS_MAGIC;
+    if (!put(file, &magic, sizeof(magic)) || !put(file, &count, sizeof(count))) {
+        return FALSE;
+    }
+    for (sc_uint i = 0; i < count; i++) {
+        const font_atlas * atlas = &atlases[i];
+        sc_ushort path_length = slen(atlas->path_);
+        if (!put(file, &path_length, sizeof(path_length)) ||
+            !put(file, atlas->path_, path_length) ||
+            !put(file, &atlas->point_, sizeof(atlas->point_)) ||
+            !put(file, &atlas->height_, sizeof(atlas->height_)) ||
+            !put(file, &atlas->ascent_, sizeof(atlas->ascent_)) ||
+            !put(file, &atlas->descent_, sizeof(atlas->descent_)) ||
+            !put(file, &atlas->width_, sizeof(atlas->width_)) ||
+            !put(file, &atlas->rows_, sizeof(atlas->rows_)) ||
+            !put(file, &atlas->glyph_count_, sizeof(atlas->glyph_count_)) ||
+            !put(file, atlas->glyphs_, atlas->glyph_count_ * sizeof(font_atlas_glyph)) ||
+            !put(file, atlas->coverage_, atlas->width_ * atlas->rows_)) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+font_atlas * read_font_atlases(FILE * file, sc_uint * count) {
+    sc_uint magic;
+    if (!get(file, &magic, sizeof(magic)) || magic != FONT_ATLAS_MAGIC ||
+        !get(file, count, sizeof(sc_uint))) {
+        sc_error("Error reading font atlases from file\n");
+        return NULL;
+    }
+
+    font_atlas * atlases = (font_atlas*)calloc(*count, sizeof(font_atlas));
+    for (sc_uint i = 0; i < *count; i++) {
+        font_atlas * atlas = &atlases[i];
+        sc_ushort path_length;
+        sc_bool ok = get(file, &path_length, sizeof(path_length)) && path_length < FONT_ATLAS_MAX_PATH &&
+            get(file, atlas->path_, path_length) &&
+            get(file, &atlas->point_, sizeof(atlas->point_)) &&
+            get(file, &atlas->height_, sizeof(atlas->height_)) &&
+            get(file, &atlas->ascent_, sizeof(atlas->ascent_)) &&
+            get(file, &atlas->descent_, sizeof(atlas->descent_)) &&
+            get(file, &atlas->width_, sizeof(atlas->width_)) &&
+            get(file, &atlas->rows_, sizeof(atlas->rows_)) &&
+            get(file, &atlas->glyph_count_, sizeof(atlas->glyph_count_));
+        if (ok) {
+            atlas->path_[path_length] = '\0';
+            atlas->glyphs_ = (font_atlas_glyph*)malloc(atlas->glyph_count_ * sizeof(font_atlas_glyph));
+            atlas->coverage_ = (sc_uchar*)malloc(atlas->width_ * atlas->rows_);
+            ok = get(file, atlas->glyphs_, atlas->glyph_count_ * sizeof(font_atlas_glyph)) &&
+                 get(file, atlas->coverage_, atlas->width_ * atlas->rows_);
+        }
+        if (!ok) {
+            sc_error("Error reading font atlases from file\n");
+            delete_font_atlases(atlases, i + 1);
+            return NULL;
+        }
+    }
+    return atlases;
+}
+
+void delete_font_atlases(font_atlas * atlases, sc_uint count) {
+    if (atlases) {
+        for (sc_uint i = 0; i < count; i++) {
+            free(atlases[i].glyphs_);
+            free(atlases[i].coverage_);
+        }
+        free(atlases);
+    }
+}
@@ -0,0 +1,82 @@
+/* This file is part of {{ samplecontrol }}.
+ *
+ * 2024 Benedict R. Gaster (cuberoo_)
+ *
+ * Licensed under either of
+ * Apache License, Version 2.0 (LICENSE-APACHE or http://www.apache.org/licenses/LICENSE-2.0)
+ * MIT license (LICENSE-MIT or http://opensource.org/licenses/MIT)
+ * at your option.
+ */
+
+#include <generator.h>
+
+void attach_generator(sc_generator * generator, sc_queue * queue, sc_uint rate, sc_uint flags) {
+    atomic_store(&generator->rate_, rate);
+    atomic_store(&generator->flags_, flags);
+    // rate and flags are visible before the queue
+    atomic_store_explicit(&generator->queue_, queue, memory_order_release);
+}
+
+sc_bool generator_attached(sc_generator * generator) {
+    return atomic_load_explicit(&generator->queue_, memory_order_acquire) != NULL;
+}
+
+void generator_tick(sc_generator * generator, unsigned long long now) {
+    sc_queue * queue = atomic_load_explicit(&generator->queue_, memory_order_acquire);
+    if (queue == NULL) {
+        return;
+    }
+    sc_uint rate = atomic_load_explicit(&generator->rate_, memory_order_relaxed);
+    sc_uint flags = atomic_load_explicit(&generator->flags_, memory_order_relaxed);
+
+    sc_bool resend = (flags & STREAM_CONTINUOUS) && rate > 0 && generator->sent_;
+    if (!generator->held_ && !resend) {
+        return;
+    }
+    if (rate > 0 && now < generator->next_ns_) {
+        return;
+    }
+    if ((flags & STREAM_LATEST) && !is_empty(queue)) {
+        // consumer has not caught up, keep holding the newest
+        return;
+    }
+    if (!enqueue(queue, generator->value_)) {
+        // full, try again next tick rather than lose the latest
+        return;
+    }
+    generator->held_ = FALSE;
+    generator->sent_ = TRUE;
+
+    if (rate > 0) {
+        // keep to a fixed grid, unless nothing was sent for a whole period
+        unsigned long long period = 1000000000ULL / rate;
+        if (generator->next_ns_ == 0 || now - generator->next_ns_ > period) {
+            generator->next_ns_ = now;
+        }
+        generator->next_ns_ += period;
+    }
+}
+
+void generator_sample(sc_generator * generator, sc_uint value, unsigned long long now) {
+    if (generator->held_) {
+        generator->coalesced_++;
+    }
+    generator->value_ = value;
+    generator->held_ = TRUE;
+    generator_tick(generator, now);
+}
+
+void generator_event(sc_generator * generator, sc_uint value) {
+    sc_queue * queue = atomic_load_explicit(&generator->queue_, memory_order_acquire);
+    if (queue == NULL) {
+        return;
+    }
+    if (generator->held_ && enqueue(queue, generator->value_)) {
+        // flush sample first, so the event is seen after it
+        generator->held_ = FALSE;
+        generator->sent_ = TRUE;
+    }
+    if (!enqueue(queue, value)) {
+        generator->dropped_++;
+    }
+}
@@ -13,15 +13,16 @@
 
 #include <lfqueue.h>
 
+// single producer, single consumer, head and tail only ever increase
 struct sc_queue_t {
-    atomic_int head;
-    atomic_int tail;
+    atomic_uint head;
+    atomic_uint tail;
     sc_uint length;
     sc_uint data[];
 };
 
 sc_queue * allocate_queue(sc_uint num) {
-    sc_queue * q = (sc_queue*)malloc(sizeof(sc_queue) + num*sizeof(sc_uint*));
+    sc_queue * q = (sc_queue*)malloc(sizeof(sc_queue) + num*sizeof(sc_uint));
     q->head = 0;
     q->tail = 0;
     q->length = num;
@@ -32,24 +33,24 @@ sc_queue * allocate_queue(sc_uint num) {
 }
 
 sc_bool enqueue(sc_queue *queue, sc_uint value) {
-    int tail = atomic_fetch_add_explicit(&queue->tail, 1, memory_order_release);
-
-    if ((tail + 1) % queue->length == queue->head) {
+    sc_uint tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    if (tail - atomic_load_explicit(&queue->head, memory_order_acquire) >= queue->length) {
         // Queue is full
         return FALSE;
     }
     queue->data[tail % queue->length] = value;
-    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
     return TRUE;
 }
 
 sc_uint dequeue(sc_queue *queue) {
-    sc_uint head = atomic_fetch_add_explicit(&queue->head, 1, memory_order_release);
+    sc_uint head = atomic_load_explicit(&queue->head, memory_order_relaxed);
     sc_uint value = queue->data[head % queue->length];
-    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
     return value;
 }
 
 sc_bool is_empty(sc_queue *queue) {
-    return queue->head == queue->tail ? TRUE : FALSE;
-}
\ No newline at end of file
+    return atomic_load_explicit(&queue->head, memory_order_relaxed) == 
+           atomic_load_explicit(&queue->tail, memory_order_acquire) ? TRUE : FALSE;
+}
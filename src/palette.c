@@ -0,0 +1,65 @@
+/* This file is part of {{ samplecontrol }}.
+ *
+ * 2024 Benedict R. Gaster (cuberoo_)
+ *
+ * Licensed under either of
+ * Apache License, Version 2.0 (LICENSE-APACHE or http://www.apache.org/licenses/LICENSE-2.0)
+ * MIT license (LICENSE-MIT or http://opensource.org/licenses/MIT)
+ * at your option.
+ */
+
+#include <palette.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+ #include <immintrin.h>
+ #define PALETTE_HAS_AVX2 1
+#else
+ #define PALETTE_HAS_AVX2 0
+#endif
+
+static void expand_scalar(const sc_uchar * src, sc_uint * dst, sc_uint count, const sc_uint * palette) {
+    sc_uint i = 0;
+    for (; i + 4 <= count; i += 4) {
+        sc_uint a = palette[src[i]];
+        sc_uint b = palette[src[i+1]];
+        sc_uint c = palette[src[i+2]];
+        sc_uint d = palette[src[i+3]];
+        dst[i] = a;
+        dst[i+1] = b;
+        dst[i+2] = c;
+        dst[i+3] = d;
+    }
+    for (; i < count; i++) {
+        dst[i] = palette[src[i]];
+    }
+}
+
+#if PALETTE_HAS_AVX2
+__attribute__((target("avx2")))
+static void expand_avx2(const sc_uchar * src, sc_uint * dst, sc_uint count, const sc_uint * palette) {
+    sc_uint i = 0;
+    for (; i + 16 <= count; i += 16) {
+        // widen 8 indices at a time to 32-bit lanes, then gather from palette
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(src + i));
+        __m256i lo = _mm256_cvtepu8_epi32(bytes);
+        __m256i hi = _mm256_cvtepu8_epi32(_mm_srli_si128(bytes, 8));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_i32gather_epi32((const int*)palette, lo, 4));
+        _mm256_storeu_si256((__m256i*)(dst + i + 8), _mm256_i32gather_epi32((const int*)palette, hi, 4));
+    }
+    expand_scalar(src + i, dst + i, count - i, palette);
+}
+#endif
+
+void palette_expand(const sc_uchar * src, sc_uint * dst, sc_uint count, const sc_uint * palette) {
+#if PALETTE_HAS_AVX2
+    static sc_int has_avx2 = -1;
+    if (has_avx2 < 0) {
+        has_avx2 = __builtin_cpu_supports("avx2") ? TRUE : FALSE;
+    }
+    if (has_avx2) {
+        expand_avx2(src, dst, count, palette);
+        return;
+    }
+#endif
+    expand_scalar(src, dst, count, palette);
+}
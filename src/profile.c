@@ -0,0 +1,402 @@
+/* This file is part of {{ samplecontrol }}.
+ *
+ * 2024 Benedict R. Gaster (cuberoo_)
+ *
+ * Licensed under either of
+ * Apache License, Version 2.0 (LICENSE-APACHE or http://www.apache.org/licenses/LICENSE-2.0)
+ * MIT license (LICENSE-MIT or http://opensource.org/licenses/MIT)
+ * at your option.
+ */
+
+#include <profile.h>
+
+#if defined(__PROFILE__) && __PROFILE__ > 0
+
+#include <string.h>
+#include <time.h>
+
+//-----------------------------------------------------------------------------------------------
+// limits
+//-----------------------------------------------------------------------------------------------
+
+// must match scem
+#define PROFILE_MAX_TASKS 16
+#define PROFILE_MAX_PC (1024 * 32)
+#define PROFILE_MAX_OPCODES 256
+
+#define MAX_SYMBOLS 1024
+#define MAX_SYMBOL_LENGTH 256
+#define MAX_PATH_LENGTH 4096
+
+//-----------------------------------------------------------------------------------------------
+// Types
+//-----------------------------------------------------------------------------------------------
+
+// calling context tree, one per task, each node is a function entry pc
+typedef struct profile_node {
+    sc_uint pc_;
+    unsigned long long count_;
+    struct profile_node *parent_;
+    struct profile_node *child_;
+    struct profile_node *sibling_;
+} profile_node;
+
+typedef struct {
+    sc_char kind_[8];
+    sc_char name_[MAX_SYMBOL_LENGTH];
+    sc_uint pc_;
+} symbol;
+
+typedef struct {
+    unsigned long long calls_;
+    unsigned long long ns_;
+} device_timing;
+
+//-----------------------------------------------------------------------------------------------
+// Globals
+//-----------------------------------------------------------------------------------------------
+
+// these must be kept in the same order as the opcode enum in scem
+static const sc_char * opcode_names[] = {
+    "MOV", "MOVL", "SREAD", "SWRITE", "SREADY",
+    "JMP", "JMPZ", "JMPNZ", "NOP", "CMP", "CMPLT", "CALL", "RET", "HALT",
+    "ADD", "SUB", "MUL", "DIV", "MOD", "FTOI",
+    "ADDF", "SUBF", "MULF", "ITOF",
+    "SHIFTR", "SHIFTL", "AND", "OR", "XOR",
+    "LDL", "PUSH", "POP",
+    "LDR", "STR", "LDRB", "STRB", "LDRH", "STRH", "LDRSB", "LDRSH",
+    "SPAWN", "YIELD", "START",
+    "CONSOLE", "SCREEN", "MOUSE",
+    "STREAM", "SETSF", "SETSC",
+    "ATTACH", "AWAIT",
+};
+
+static const sc_char * device_names[PROFILE_NUM_DEVICES] = { "CONSOLE", "SCREEN" };
+
+static sc_bool profiling = FALSE;
+static sc_bool timing_devices = FALSE;
+static sc_char rom_path[MAX_PATH_LENGTH];
+
+static unsigned long long opcode_counts[PROFILE_MAX_OPCODES];
+static unsigned long long *pc_counts[PROFILE_MAX_TASKS];
+static sc_uchar pc_opcodes[PROFILE_MAX_PC];
+
+static profile_node *task_roots[PROFILE_MAX_TASKS];
+static profile_node *task_current[PROFILE_MAX_TASKS];
+
+static device_timing device_timings[PROFILE_NUM_DEVICES][PROFILE_MAX_DEVICE_COMMANDS];
+static struct timespec device_start;
+
+static symbol symbols[MAX_SYMBOLS];
+static sc_uint symbol_count = 0;
+
+//-----------------------------------------------------------------------------------------------
+// Symbols
+//-----------------------------------------------------------------------------------------------
+
+static void load_symbols() {
+    sc_char path[MAX_PATH_LENGTH + 8];
+    snprintf(path, sizeof(path), "%s.sym", rom_path);
+
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        return;
+    }
+
+    sc_char line[MAX_SYMBOL_LENGTH * 2];
+    while (fgets(line, sizeof(line), file) && symbol_count < MAX_SYMBOLS) {
+        symbol *sym = &symbols[symbol_count];
+        if (line[0] != ';' && sscanf(line, "%7s %255s %u", sym->kind_, sym->name_, &sym->pc_) == 3) {
+            symbol_count++;
+        }
+    }
+    fclose(file);
+}
+
+/**
+ * @brief find symbol that starts exactly at pc
+ */
+static const symbol * symbol_at(sc_uint pc) {
+    for (sc_uint i = 0; i < symbol_count; i++) {
+        if (symbols[i].pc_ == pc) {
+            return &symbols[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief find symbol for the function or task that contains pc
+ */
+static const symbol * symbol_containing(sc_uint pc) {
+    const symbol * best = NULL;
+    for (sc_uint i = 0; i < symbol_count; i++) {
+        if (symbols[i].pc_ <= pc && (best == NULL || symbols[i].pc_ > best->pc_)) {
+            best = &symbols[i];
+        }
+    }
+    return best;
+}
+
+static void symbol_name(sc_uint pc, sc_char * dst, sc_size_t len) {
+    const symbol * sym = symbol_at(pc);
+    if (sym) {
+        snprintf(dst, len, "%s", sym->name_);
+    }
+    else {
+        snprintf(dst, len, "pc_%u", pc);
+    }
+}
+
+//-----------------------------------------------------------------------------------------------
+// Hooks
+//-----------------------------------------------------------------------------------------------
+
+static profile_node * make_node(sc_uint pc, profile_node *parent) {
+    profile_node *node = (profile_node*)calloc(1, sizeof(profile_node));
+    node->pc_ = pc;
+    node->parent_ = parent;
+    if (parent) {
+        node->sibling_ = parent->child_;
+        parent->child_ = node;
+    }
+    return node;
+}
+
+sc_bool has_profiler() {
+    return TRUE;
+}
+
+sc_bool enable_profiler(const sc_char * rom, sc_bool time_devices) {
+    snprintf(rom_path, sizeof(rom_path), "%s", rom);
+    for (sc_int i = 0; i < PROFILE_MAX_TASKS; i++) {
+        pc_counts[i] = (unsigned long long*)calloc(PROFILE_MAX_PC, sizeof(unsigned long long));
+        if (pc_counts[i] == NULL) {
+            sc_error("ERROR: failed to allocate profile\n");
+            return FALSE;
+        }
+    }
+    load_symbols();
+    timing_devices = time_devices;
+    profiling = TRUE;
+    atexit(write_profile);
+    return TRUE;
+}
+
+void profile_task(sc_uint task_id, sc_uint pc) {
+    if (profiling && task_id < PROFILE_MAX_TASKS) {
+        task_roots[task_id] = make_node(pc, NULL);
+        task_current[task_id] = task_roots[task_id];
+    }
+}
+
+void profile_instruction(sc_uint task_id, sc_uint pc, sc_uint opcode) {
+    if (profiling) {
+        opcode_counts[opcode & 0xFF]++;
+        pc_counts[task_id][pc]++;
+        pc_opcodes[pc] = opcode;
+        task_current[task_id]->count_++;
+    }
+}
+
+void profile_call(sc_uint task_id, sc_uint pc_target) {
+    if (profiling) {
+        profile_node *current = task_current[task_id];
+        profile_node *child = current->child_;
+        while (child && child->pc_ != pc_target) {
+            child = child->sibling_;
+        }
+        if (child == NULL) {
+            child = make_node(pc_target, current);
+        }
+        task_current[task_id] = child;
+    }
+}
+
+void profile_ret(sc_uint task_id) {
+    if (profiling && task_current[task_id]->parent_) {
+        task_current[task_id] = task_current[task_id]->parent_;
+    }
+}
+
+void profile_device_begin() {
+    if (timing_devices) {
+        clock_gettime(CLOCK_MONOTONIC, &device_start);
+    }
+}
+
+void profile_device_end(sc_uint device, sc_uint command) {
+    if (timing_devices && command < PROFILE_MAX_DEVICE_COMMANDS) {
+        struct timespec end_time;
+        clock_gettime(CLOCK_MONOTONIC, &end_time);
+        device_timing *dt = &device_timings[device][command];
+        dt->calls_++;
+        dt->ns_ += (end_time.tv_sec - device_start.tv_sec) * 1000000000LL +
+                   end_time.tv_nsec - device_start.tv_nsec;
+    }
+}
+
+//-----------------------------------------------------------------------------------------------
+// Report
+//-----------------------------------------------------------------------------------------------
+
+static unsigned long long *sort_counts;
+
+static int compare_pcs(const void *a, const void *b) {
+    unsigned long long ca = sort_counts[*(const sc_uint*)a];
+    unsigned long long cb = sort_counts[*(const sc_uint*)b];
+    return ca < cb ? 1 : (ca > cb ? -1 : 0);
+}
+
+static void write_folded(FILE *file, profile_node *node, sc_char *path, sc_size_t path_length) {
+    sc_char name[MAX_SYMBOL_LENGTH];
+    symbol_name(node->pc_, name, sizeof(name));
+
+    sc_size_t length = path_length;
+    if (length > 0 && length < MAX_PATH_LENGTH - 1) {
+        path[length++] = ';';
+    }
+    length += snprintf(path + length, MAX_PATH_LENGTH - length, "%s", name);
+    if (length >= MAX_PATH_LENGTH) {
+        length = MAX_PATH_LENGTH - 1;
+    }
+
+    if (node->count_ > 0) {
+        fprintf(file, "%s %llu\n", path, node->count_);
+    }
+    for (profile_node *child = node->child_; child; child = child->sibling_) {
+        write_folded(file, child, path, length);
+    }
+    path[path_length] = '\0';
+}
+
+void write_profile() {
+    if (!profiling) {
+        return;
+    }
+    profiling = FALSE;
+
+    sc_char path[MAX_PATH_LENGTH + 8];
+    snprintf(path, sizeof(path), "%s.prof", rom_path);
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        sc_error("ERROR: could not open profile %s\n", path);
+        return;
+    }
+
+    unsigned long long total = 0;
+    for (sc_int op = 0; op < PROFILE_MAX_OPCODES; op++) {
+        total += opcode_counts[op];
+    }
+
+    fprintf(file, "; scem profile for %s\n", rom_path);
+    fprintf(file, "; instructions %llu\n\n", total);
+
+    // opcodes, in order of count
+    sc_uint order[PROFILE_MAX_PC];
+    sc_uint count = 0;
+    for (sc_uint op = 0; op < PROFILE_MAX_OPCODES; op++) {
+        if (opcode_counts[op] > 0) {
+            order[count++] = op;
+        }
+    }
+    sort_counts = opcode_counts;
+    qsort(order, count, sizeof(sc_uint), compare_pcs);
+
+    fprintf(file, "; opcode\tcount\t%%\n");
+    for (sc_uint i = 0; i < count; i++) {
+        sc_uint op = order[i];
+        fprintf(file, "op\t%s\t%llu\t%.2f\n",
+            op < sizeof(opcode_names) / sizeof(opcode_names[0]) ? opcode_names[op] : "?",
+            opcode_counts[op], 100.0 * opcode_counts[op] / (total ? total : 1));
+    }
+
+    // per task pcs, in order of count
+    fprintf(file, "\n; task\tpc\tcount\t%%\topcode\tsymbol\n");
+    for (sc_uint t = 0; t < PROFILE_MAX_TASKS; t++) {
+        if (task_roots[t] == NULL) {
+            continue;
+        }
+        count = 0;
+        for (sc_uint pc = 0; pc < PROFILE_MAX_PC; pc++) {
+            if (pc_counts[t][pc] > 0) {
+                order[count++] = pc;
+            }
+        }
+        sort_counts = pc_counts[t];
+        qsort(order, count, sizeof(sc_uint), compare_pcs);
+
+        for (sc_uint i = 0; i < count; i++) {
+            sc_uint pc = order[i];
+            const symbol *sym = symbol_containing(pc);
+            fprintf(file, "pc\t%u\t%u\t%llu\t%.2f\t%s\t%s+%u\n", t, pc, pc_counts[t][pc],
+                100.0 * pc_counts[t][pc] / (total ? total : 1),
+                pc_opcodes[pc] < sizeof(opcode_names) / sizeof(opcode_names[0]) ? opcode_names[pc_opcodes[pc]] : "?",
+                sym ? sym->name_ : "pc_0", sym ? pc - sym->pc_ : pc);
+        }
+    }
+
+    // device timings
+    if (timing_devices) {
+        fprintf(file, "\n; device\tcommand\tcalls\ttotal ns\tavg ns\n");
+        for (sc_uint d = 0; d < PROFILE_NUM_DEVICES; d++) {
+            for (sc_uint c = 0; c < PROFILE_MAX_DEVICE_COMMANDS; c++) {
+                device_timing *dt = &device_timings[d][c];
+                if (dt->calls_ > 0) {
+                    fprintf(file, "device\t%s\t%u\t%llu\t%llu\t%llu\n",
+                        device_names[d], c, dt->calls_, dt->ns_, dt->ns_ / dt->calls_);
+                }
+            }
+        }
+    }
+    fclose(file);
+
+    // folded stacks, i.e. task;func;func count
+    snprintf(path, sizeof(path), "%s.folded", rom_path);
+    file = fopen(path, "w");
+    if (file == NULL) {
+        sc_error("ERROR: could not open folded stacks %s\n", path);
+        return;
+    }
+    sc_char stack[MAX_PATH_LENGTH];
+    for (sc_uint t = 0; t < PROFILE_MAX_TASKS; t++) {
+        if (task_roots[t]) {
+            stack[0] = '\0';
+            write_folded(file, task_roots[t], stack, 0);
+        }
+    }
+    fclose(file);
+}
+
+#else // __PROFILE__
+
+sc_bool has_profiler() {
+    return FALSE;
+}
+
+sc_bool enable_profiler(const sc_char * rom, sc_bool time_devices) {
+    return FALSE;
+}
+
+void profile_task(sc_uint task_id, sc_uint pc) {
+}
+
+void profile_instruction(sc_uint task_id, sc_uint pc, sc_uint opcode) {
+}
+
+void profile_call(sc_uint task_id, sc_uint pc_target) {
+}
+
+void profile_ret(sc_uint task_id) {
+}
+
+void profile_device_begin() {
+}
+
+void profile_device_end(sc_uint device, sc_uint command) {
+}
+
+void write_profile() {
+}
+
+#endif // !__PROFILE__
@@ -9,6 +9,11 @@
  */
 
 #include <util.h>
+#include <font_atlas.h>
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
 
 //-----------------------------------------------------------------------------------------------
 // limits
@@ -23,8 +28,16 @@
 // max 8K 32-bit literals
 #define MAX_LITERALS 1024 * 8
 
-// max 4K labels
-#define MAX_LABELS 1024 * 4
+// max 16K labels
+#define MAX_LABELS 1024 * 16
+
+// open addressed, so kept at most half full, must be a power of 2
+#define LABEL_TABLE_SIZE (MAX_LABELS * 2)
+#define LITERAL_TABLE_SIZE (MAX_LITERALS * 2)
+#define OPCODE_TABLE_SIZE 128
+
+// max 1K @func and @task symbols
+#define MAX_SYMBOLS 1024
 
 #define MAX_LABEL_LENGTH 256
 
@@ -33,7 +46,7 @@
 #define MAX_OPCODE_SIZE 7
 
 #define MAX_TOPLEVEL_SIZE 10
-#define MAX_DEVICE_SIZE 10
+#define MAX_DEVICE_SIZE 12
 
 //-----------------------------------------------------------------------------------------------
 // some useful macros
@@ -44,6 +57,10 @@
 #define error_asm(id) printf("%s: %s in @%s, %s:%d.\n", id, token, scope, ctx->path, ctx->line)
 #define error_ref(id) printf("%s: %s, %s:%d\n", id, r->name, r->data, r->line)
 
+// string of a macro's value, e.g. for scanf field widths
+#define stringize_value(x) stringize(x)
+#define stringize(x) #x
+
 //-----------------------------------------------------------------------------------------------
 // Types
 //-----------------------------------------------------------------------------------------------
@@ -56,13 +73,16 @@ enum {
 
 typedef struct {
     sc_char *str_;
-    sc_int hash_;
+    sc_uint hash_;
 } string;
 
 typedef struct {
     string name_;
     sc_int offset_;
     sc_uint segment_;
+    // register window saved/restored by CALL/RET, declared with @window
+    sc_uchar window_base_;
+    sc_uchar window_count_;
 } label;
 
 typedef union {
@@ -273,12 +293,21 @@ static sc_char* src_buffer;
 static sc_uint line = 1;
 static sc_char label_prefix[MAX_LABEL_LENGTH] = { 0 };
 
+// label of the @func currently being parsed, NULL outside of a function
+static label* current_func = NULL;
+
 #define ENTRY_NOTDEFINED -1
 static sc_int entry_point = ENTRY_NOTDEFINED;
 
 static sc_uint device_capabilities = 0;
 #define USE_DEVICE_CONSOLE 0x1
 #define USE_DEVICE_SCREEN (0x1 << 1) 
+#define USE_FONT_ATLAS (0x1 << 2)
+
+// glyph atlases, see @font
+#define MAX_FONT_ATLASES 16
+static font_atlas font_atlases[MAX_FONT_ATLASES];
+static sc_uint font_atlas_count = 0;
 
 static sc_uint current_segment = SEGMENT_NOT_SET;
 
@@ -292,49 +321,413 @@ static sc_ushort literal_count = 0;
 
 // label pool
 static label labels[MAX_LABELS];
-static sc_ushort label_count = 0;
+static sc_uint label_count = 0;
 
-sc_ushort push_literal_32(sc_uint l) {
-    // add any necessary padding for alignment
-    literal_count = literal_count + (literal_count % 4);
+// index + 1 into labels, 0 if empty
+static sc_uint label_table[LABEL_TABLE_SIZE];
+
+// @func and @task symbols, see emit_symbols
+enum { SYM_FUNC, SYM_TASK };
+
+typedef struct {
+    sc_int kind_;
+    label * label_;
+} symbol;
+
+static symbol symbols[MAX_SYMBOLS];
+static sc_ushort symbol_count = 0;
+
+//-----------------------------------------------------------------------------------------------
+// Modules, see @include
+//-----------------------------------------------------------------------------------------------
+
+// While a module is parsed, what it adds to the program is recorded, so that it can be
+// stored in the module cache and replayed the next time it is included, without being
+// parsed again. Labels and literals are referred to by the event that made them, as
+// their offsets depend on what was assembled before the module.
+enum {
+    EV_INSTRUCTION,     // values_ opcode and operand count, operands_ as types_
+    EV_LABEL,           // text_ name, prefix_, values_[0] true if definition
+    EV_LITERAL_32,      // values_[0]
+    EV_LITERAL_16,
+    EV_LITERAL_8,
+    EV_CONSTANT_32,     // values_[0], interned
+    EV_STRING,          // text_, interned
+    EV_SYMBOL,          // values_ kind and label event
+    EV_WINDOW,          // values_ label event, base, and count
+    EV_ENTRY,
+    EV_SEGMENT,         // values_[0]
+    EV_CAPABILITIES,    // values_[0]
+    EV_FONT,            // text_ path, values_[0] point
+    EV_INCLUDE,         // text_ name, as written
+    EV_MACRO,           // text_ body, prefix_ name, values_[0] line of body
+    EV_EXPAND,          // text_ name and arguments, as written, prefix_
+};
+
+typedef struct {
+    sc_uint kind_;
+    sc_uint values_[3];
+    sc_uchar types_[3];
+    sc_uint operands_[3];   // label and literal operands are event indices
+    sc_char * text_;
+    sc_uint text_length_;
+    sc_char * prefix_;
+    // set when recorded or replayed, not stored
+    label * label_;
+    sc_ushort offset_;
+} module_event;
+
+typedef struct {
+    module_event * events_;
+    sc_uint count_;
+    sc_uint capacity_;
+    sc_bool valid_;         // false if something could not be recorded
+} module_log;
+
+// log of module being parsed, NULL if not caching or replaying
+static module_log * recording = NULL;
+
+// number of macro expansions being parsed, see @macro
+static sc_uint macro_depth = 0;
+
+#define MAX_MACRO_DEPTH 16
+
+// each expansion being parsed, outermost first, so a label can be resolved
+// where the macro is used when it is not one of the macro's own
+typedef struct {
+    const sc_char * body_;      // of macro, before its arguments are substituted
+    const sc_char * prefix_;    // label prefix where the macro is used
+} expansion_scope;
+
+static expansion_scope expansion_scopes[MAX_MACRO_DEPTH];
+
+#define MAX_INCLUDE_PATHS 64
+#define MAX_INCLUDES 256
+
+// searched by @include, after the directory of the including file
+static const sc_char * include_paths[MAX_INCLUDE_PATHS];
+static sc_uint include_path_count = 0;
+
+// directory of module cache, NULL if not caching
+static const sc_char * module_cache = NULL;
+
+// real paths of files already included, so each is only included once
+static sc_char * included[MAX_INCLUDES];
+static sc_uint included_count = 0;
+
+// directory of file being parsed
+static sc_char current_dir[PATH_MAX] = ".";
+
+sc_bool include_file(const sc_char * name);
+sc_bool parse();
+
+void set_include_paths(sc_char ** paths, sc_uint count) {
+    include_path_count = count < MAX_INCLUDE_PATHS ? count : MAX_INCLUDE_PATHS;
+    for (sc_uint i = 0; i < include_path_count; i++) {
+        include_paths[i] = paths[i];
+    }
+}
+
+void set_module_cache(const sc_char * dir) {
+    module_cache = dir;
+}
+
+static void set_current_dir(const sc_char * real) {
+    sc_int length = slen(real);
+    while (length > 0 && real[length-1] != '/') {
+        length--;
+    }
+    // keep the / of the root directory
+    if (length > 1) {
+        length--;
+    }
+    mcopy(real, current_dir, length);
+    current_dir[length] = '\0';
+}
+
+/**
+ * @brief remember file has been included
+ *
+ * @param real path of file
+ * @return false if already included, otherwise true
+ */
+static sc_bool mark_included(const sc_char * real) {
+    for (sc_uint i = 0; i < included_count; i++) {
+        if (strcmp(included[i], real) == 0) {
+            return FALSE;
+        }
+    }
+    if (included_count < MAX_INCLUDES) {
+        included[included_count++] = strdup(real);
+    }
+    return TRUE;
+}
+
+/**
+ * @brief true if events are to be recorded
+ *
+ * a macro expansion is recorded as the macro's name and arguments, and expanded again
+ * when replayed, so nothing it adds is recorded
+ */
+static sc_bool is_recorded() {
+    return recording && macro_depth == 0;
+}
+
+static module_event * record_event(sc_uint kind) {
+    if (recording->count_ == recording->capacity_) {
+        recording->capacity_ = recording->capacity_ ? recording->capacity_ * 2 : 256;
+        recording->events_ = (module_event*)realloc(
+            recording->events_, recording->capacity_ * sizeof(module_event));
+    }
+    module_event * event = &recording->events_[recording->count_++];
+    memset(event, 0, sizeof(module_event));
+    event->kind_ = kind;
+    return event;
+}
+
+static sc_char * copy_text(const sc_char * text, sc_uint length) {
+    sc_char * copy = (sc_char*)malloc(length + 1);
+    mcopy(text, copy, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+static void record_text(sc_uint kind, const sc_char * text, sc_uint length, sc_uint value) {
+    if (is_recorded()) {
+        module_event * event = record_event(kind);
+        event->text_ = copy_text(text, length);
+        event->text_length_ = length;
+        event->values_[0] = value;
+    }
+}
+
+static void record_value(sc_uint kind, sc_uint value, sc_ushort offset) {
+    if (is_recorded()) {
+        module_event * event = record_event(kind);
+        event->values_[0] = value;
+        event->offset_ = offset;
+    }
+}
+
+static sc_bool find_label_event(label * lab, sc_uint * index) {
+    for (sc_uint i = recording->count_; i-- > 0;) {
+        if (recording->events_[i].kind_ == EV_LABEL && recording->events_[i].label_ == lab) {
+            *index = i;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static sc_bool find_literal_event(sc_ushort offset, sc_uint * index) {
+    for (sc_uint i = recording->count_; i-- > 0;) {
+        sc_uint kind = recording->events_[i].kind_;
+        if (kind >= EV_LITERAL_32 && kind <= EV_STRING && recording->events_[i].offset_ == offset) {
+            *index = i;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static void record_label(const sc_char * name, sc_bool definition, label * lab) {
+    if (is_recorded()) {
+        module_event * event = record_event(EV_LABEL);
+        event->text_ = copy_text(name, slen(name));
+        event->text_length_ = slen(name);
+        event->prefix_ = copy_text(label_prefix, slen(label_prefix));
+        event->values_[0] = definition;
+        event->label_ = lab;
+    }
+}
+
+static void record_label_use(sc_uint kind, label * lab, sc_uint base, sc_uint count) {
+    if (is_recorded()) {
+        sc_uint index;
+        if (!find_label_event(lab, &index)) {
+            recording->valid_ = FALSE;
+            return;
+        }
+        module_event * event = record_event(kind);
+        event->values_[0] = index;
+        event->values_[1] = base;
+        event->values_[2] = count;
+    }
+}
+
+static void record_instruction(instruction i) {
+    module_event * event = record_event(EV_INSTRUCTION);
+    event->values_[0] = i.opcode_;
+    event->values_[1] = i.operand_count_;
+    for (sc_int o = 0; o < i.operand_count_; o++) {
+        operand op = i.operands_[o];
+        event->types_[o] = op.type_;
+        if (op.type_ == OP_Label) {
+            if (!find_label_event(op.op_.label_, &event->operands_[o])) {
+                recording->valid_ = FALSE;
+            }
+        }
+        else if (op.type_ == OP_Lit) {
+            if (!find_literal_event(op.op_.literal_, &event->operands_[o])) {
+                recording->valid_ = FALSE;
+            }
+        }
+        else if (op.type_ == OP_Reg) {
+            event->operands_[o] = op.op_.operand_;
+        }
+        else {
+            event->operands_[o] = op.op_.literal_;
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------------------------
+//-----------------------------------------------------------------------------------------------
+
+void push_symbol(sc_int kind, label * lab) {
+    if (symbol_count < MAX_SYMBOLS) {
+        symbol sym = { kind, lab };
+        symbols[symbol_count++] = sym;
+        record_label_use(EV_SYMBOL, lab, kind, 0);
+    }
+}
+
+// literals pushed by an instruction operand, e.g. #1 or "hello", are interned, so each
+// value is in the pool once however often it is used, data, e.g. WORD, is not
+enum { LITERAL_EMPTY, LITERAL_WORD, LITERAL_STRING };
+
+typedef struct {
+    sc_uint hash_;
+    sc_ushort offset_;
+    sc_ushort length_;      // in bytes, not including '\0' of a string
+    sc_uchar kind_;
+} interned_literal;
+
+static interned_literal literal_table[LITERAL_TABLE_SIZE];
+static sc_uint interned_count = 0;
+
+static sc_uint hash_bytes(const sc_uchar * bytes, sc_uint length) {
+    sc_uint hash = 2166136261u;
+    for (sc_uint i = 0; i < length; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * @brief find interned literal
+ *
+ * @return entry for literal, or empty entry where it is to be added
+ */
+static interned_literal * find_literal(sc_uchar kind, const void * bytes, sc_uint length, sc_uint hash) {
+    for (sc_uint slot = hash;; slot++) {
+        interned_literal * entry = &literal_table[slot & (LITERAL_TABLE_SIZE - 1)];
+        if (entry->kind_ == LITERAL_EMPTY ||
+            (entry->hash_ == hash && entry->kind_ == kind && entry->length_ == length &&
+             memcmp(&literals[entry->offset_], bytes, length) == 0)) {
+            return entry;
+        }
+    }
+}
+
+static void add_literal(interned_literal * entry, sc_uchar kind, sc_uint length, sc_uint hash, sc_ushort offset) {
+    // when full, literals are still pushed, just not shared
+    if (interned_count < LITERAL_TABLE_SIZE / 2) {
+        entry->hash_ = hash;
+        entry->offset_ = offset;
+        entry->length_ = length;
+        entry->kind_ = kind;
+        interned_count++;
+    }
+}
+
+/**
+ * @brief pad literal pool to a multiple of alignment, a power of 2
+ */
+static void align_literals(sc_uint alignment) {
+    literal_count = (literal_count + alignment - 1) & ~(alignment - 1);
+}
+
+static sc_ushort append_literal_32(sc_uint l) {
+    align_literals(4);
     *((sc_uint*)&literals[(sc_int)literal_count]) = l;
     literal_count = literal_count + 4;
     return literal_count-4;
 }
 
+sc_ushort push_literal_32(sc_uint l) {
+    sc_ushort offset = append_literal_32(l);
+    record_value(EV_LITERAL_32, l, offset);
+    return offset;
+}
+
 sc_ushort push_literal_16(sc_ushort l) {
-    // add any necessary padding for alignment
-    literal_count = literal_count + (literal_count % 4);
+    align_literals(2);
     *((sc_ushort*)&literals[(sc_int)literal_count]) = l;
     literal_count = literal_count + 2;
+    record_value(EV_LITERAL_16, l, literal_count-2);
     return literal_count-2;
 }
 
 sc_ushort push_literal_8(sc_uchar l) {
     literals[(sc_int)literal_count] = l;
     literal_count = literal_count + 1;
+    record_value(EV_LITERAL_8, l, literal_count-1);
     return literal_count-1;
 }
 
-
+/**
+ * @brief as push_literal_32, returning the offset of the same value if already pushed
+ */
+sc_ushort intern_literal_32(sc_uint l) {
+    sc_uint hash = hash_bytes((const sc_uchar*)&l, 4);
+    interned_literal * entry = find_literal(LITERAL_WORD, &l, 4, hash);
+    sc_ushort offset;
+    if (entry->kind_ == LITERAL_WORD) {
+        offset = entry->offset_;
+    }
+    else {
+        offset = append_literal_32(l);
+        add_literal(entry, LITERAL_WORD, 4, hash, offset);
+    }
+    record_value(EV_CONSTANT_32, l, offset);
+    return offset;
+}
 
 #define get_literal(offset) (literals[(sc_int)offset])
 
-#define push_instruction(i) (instructions[instruction_count++] = i)
+void push_instruction(instruction i) {
+    instructions[instruction_count++] = i;
+    if (is_recorded()) {
+        record_instruction(i);
+    }
+}
 
 sc_ushort push_string_literal(sc_char *src, sc_int len) {
-    // be carefull to leave literals 4-byte aligned
-    //sc_char* lit_pool = (sc_char*)literals;
-    sc_ushort literal_count_tmp = literal_count;
+    // matched on length too, so a string is never shared with a longer one
+    sc_uint hash = hash_bytes((const sc_uchar*)src, len);
+    interned_literal * entry = find_literal(LITERAL_STRING, src, len, hash);
+    sc_ushort literal_count_tmp;
+    if (entry->kind_ == LITERAL_STRING) {
+        literal_count_tmp = entry->offset_;
+    }
+    else {
+        literal_count_tmp = literal_count;
+
+        mcopy(src, (sc_char*)(literals+literal_count), len);
 
-    mcopy(src, (sc_char*)(literals+literal_count), len);
+        *(((sc_char*)(literals+literal_count))+len) = '\0';
+        sc_print("%s = %d %d\n", (sc_char*)(literals+literal_count), len, literal_count);
+        // no padding, as strings are read a byte at a time
+        literal_count = literal_count + len + 1;
+        sc_print("%d\n", literal_count);
+        add_literal(entry, LITERAL_STRING, len, hash, literal_count_tmp);
+    }
 
-    *(((sc_char*)(literals+literal_count))+len) = '\0';
-    sc_print("%s = %d %d\n", (sc_char*)(literals+literal_count), len, literal_count);
-    len = len + 1;
-    // inc literal count, making sure to pad 4-byte alignment, if necessary
-    literal_count = literal_count + len ; //((len+1)/4) + ((len+1) % 4 > 0 ? 1 : 0);
-    sc_print("%d\n", literal_count);
+    if (is_recorded()) {
+        record_text(EV_STRING, src, len, 0);
+        recording->events_[recording->count_-1].offset_ = literal_count_tmp;
+    }
 
     return literal_count_tmp;
 }
@@ -393,8 +786,8 @@ const opcode opcodes[] = {
 
 
     // arithmeric
-    {"ADD", ADD, 3}, {"SUB", SUB, 3}, {"MUL", ADD, 3}, {"DIV", DIV, 3}, {"MOD", MOD, 3}, {"FTOI", FTOI, 2},
-    {"ADDF", ADD, 3}, {"SUBF", SUBF, 3}, {"MULF", ADD, 3}, {"ITOF", ITOF, 2},
+    {"ADD", ADD, 3}, {"SUB", SUB, 3}, {"MUL", MUL, 3}, {"DIV", DIV, 3}, {"MOD", MOD, 3}, {"FTOI", FTOI, 2},
+    {"ADDF", ADDF, 3}, {"SUBF", SUBF, 3}, {"MULF", MULF, 3}, {"ITOF", ITOF, 2},
     {"SHIFTR", SHIFTR, 3}, {"SHIFTL", SHIFTL, 3}, {"AND", AND, 3}, {"OR", OR, 3}, {"XOR", XOR, 3},
     {"LDL", LDL, 1}, {"PUSH", PUSH, 1}, {"POP", POP, 1},
 
@@ -413,7 +806,7 @@ const opcode opcodes[] = {
     // LDRSH                        Signed halfword
     // LDM              STM         Multiple words
 
-    {"CONSOLE", CONSOLE, 2}, // CONSOLE <console-op> REG
+    {"CONSOLE", CONSOLE, 3}, // CONSOLE <console-op> REG [REG]
     {"SCREEN", SCREEN, 3}, 
     {"MOUSE", MOUSE, 3},
 
@@ -422,25 +815,51 @@ const opcode opcodes[] = {
     {"ATTACH", ATTACH, 3}, {"AWAIT", AWAIT, 0},
  };
 
-sc_bool match_opcode(sc_char *op, opcode * dst_opcode) {
-    sc_int len = slen(op);
+// FNV-1a
+static sc_uint hash_string(const sc_char * str) {
+    sc_uint hash = 2166136261u;
+    while (*str) {
+        hash = (hash ^ (sc_uchar)*str++) * 16777619u;
+    }
+    return hash;
+}
 
+// index + 1 into opcodes, 0 if empty, filled in on first use
+static sc_uchar opcode_table[OPCODE_TABLE_SIZE];
+static sc_bool opcode_table_ready = FALSE;
+
+sc_bool match_opcode(sc_char *op, opcode * dst_opcode) {
     // return false in the case that it is a stream instruction
     // these are handled seperatly and not allowed to appear in standard
     // instruction stream for assembler
-    if (scmp("STREAM", op, 6) || scmp("ATTACH", op, len) || scmp("AWAIT", op, len)) {
+    if (scmp("STREAM", op, 6) || scmp("ATTACH", op, 7) || scmp("AWAIT", op, 6)) {
         return FALSE;
     }
 
-    for (sc_int i = 0; i < sizeof(opcodes) / sizeof(opcode); i++) {
-        if (scmp(opcodes[i].str_, op, len)) {
+    sc_uint count = sizeof(opcodes) / sizeof(opcode);
+    if (!opcode_table_ready) {
+        opcode_table_ready = TRUE;
+        for (sc_uint i = 0; i < count; i++) {
+            sc_uint slot = hash_string(opcodes[i].str_);
+            while (opcode_table[slot & (OPCODE_TABLE_SIZE - 1)] != 0) {
+                slot++;
+            }
+            opcode_table[slot & (OPCODE_TABLE_SIZE - 1)] = i + 1;
+        }
+    }
+
+    for (sc_uint slot = hash_string(op);; slot++) {
+        sc_uint i = opcode_table[slot & (OPCODE_TABLE_SIZE - 1)];
+        if (i == 0) {
+            return FALSE;
+        }
+        if (scmp(opcodes[i - 1].str_, op, MAX_OPCODE_SIZE + 1)) {
             if (dst_opcode) {
-                *dst_opcode = opcodes[i];
+                *dst_opcode = opcodes[i - 1];
             }
             return TRUE;
         }
     }
-    return FALSE;
 }
 
 
@@ -503,6 +922,13 @@ sc_int encode_instruction(instruction inst) {
             i |= (o & 0xFF);
         }
     }
+
+    // CALL carries the callee's register window in its spare operands, 
+    // base register in operand two and number of registers in operand three
+    if (inst.opcode_ == CALL && inst.operands_[0].type_ == OP_Label) {
+        label * callee = inst.operands_[0].op_.label_;
+        i |= (callee->window_base_ << 8) | callee->window_count_;
+    }
     
     return i;
 }
@@ -514,6 +940,11 @@ void print_encode_instruction(sc_uint inst, char* prefix) {
 
     if (opcodes[opcode].num_operands_ > 0) {
         sc_print("%u\t", (i >> 16) & 0xFF);
+
+        if (opcode == CALL && (i & 0xFF) > 0) {
+            // register window
+            sc_print("R%u-R%u\t", (i >> 8) & 0xFF, ((i >> 8) & 0xFF) + (i & 0xFF) - 1);
+        }
         
         if (opcodes[opcode].num_operands_ > 1) {
             sc_print("%u\t", (i >> 8) & 0xFF);
@@ -548,7 +979,7 @@ const datacode datacodes[] = {
 sc_bool match_datacode(sc_char *op, datacode * dst_datacode) {
     sc_int len = slen(op);
 
-    for (sc_int i = 0; i < sizeof(opcodes) / sizeof(opcode); i++) {
+    for (sc_int i = 0; i < sizeof(datacodes) / sizeof(datacode); i++) {
         if (scmp(datacodes[i].str_, op, len)) {
             if (dst_datacode) {
                 *dst_datacode = datacodes[i];
@@ -565,11 +996,16 @@ sc_bool match_datacode(sc_char *op, datacode * dst_datacode) {
 
 // Console device
 #define CONSOLE_WRITE 0
+#define CONSOLE_STR 1
+#define CONSOLE_STRN 2
+#define CONSOLE_INT 3
+#define CONSOLE_FLOAT 4
 
 enum { 
     SCREEN_RESIZE=0, SCREEN_PIXEL, SCREEN_FILL, SCREEN_RECT, 
     SCREEN_BLIT, SCREEN_PALETTE, SCREEN_BEGIN, SCREEN_END, SCREEN_COLOUR,
-    SCREEN_MOVE, SCREEN_FONT, SCREEN_TEXT,
+    SCREEN_MOVE, SCREEN_FONT, SCREEN_TEXT, SCREEN_FRAMEBUFFER, SCREEN_INDEXED, SCREEN_RETAIN,
+    SCREEN_RATE, SCREEN_IMAGE, SCREEN_DRAW, SCREEN_FONTREADY, SCREEN_IMAGEREADY,
 };
 
 //-----------------------------------------------------------------------------------------------
@@ -586,8 +1022,18 @@ enum {
  * @return pointer to constructed label
  */
 label* make_label(sc_char* l, sc_int loc) {
-    label lab = {{l, 0}, loc, current_segment};
+    if (label_count >= MAX_LABELS) {
+        sc_error("ERROR: line(%d) too many labels, at most %d\n", line, MAX_LABELS);
+        return NULL;
+    }
+    label lab = {{l, hash_string(l)}, loc, current_segment, 0, 0};
     labels[label_count] = lab;
+
+    sc_uint slot = lab.name_.hash_;
+    while (label_table[slot & (LABEL_TABLE_SIZE - 1)] != 0) {
+        slot++;
+    }
+    label_table[slot & (LABEL_TABLE_SIZE - 1)] = label_count + 1;
     return &labels[label_count++];
 }
 
@@ -599,56 +1045,85 @@ label* make_label(sc_char* l, sc_int loc) {
  * @return true if successful, otherwise false.
  */
 sc_bool is_label_defined(sc_char* l, label** dst_label) {
-    sc_int len = slen(l);
-    for (sc_int i = 0; i < label_count; i++) {
-        if (scmp(labels[i].name_.str_, l, len)) {
+    sc_uint hash = hash_string(l);
+    for (sc_uint slot = hash;; slot++) {
+        sc_uint i = label_table[slot & (LABEL_TABLE_SIZE - 1)];
+        if (i == 0) {
+            return FALSE;
+        }
+        label * lab = &labels[i - 1];
+        if (lab->name_.hash_ == hash && scmp(lab->name_.str_, l, MAX_LABEL_LENGTH)) {
             if (dst_label) {
-                *dst_label = &labels[i];
+                *dst_label = lab;
             }
             return TRUE;
         }
     }
-    return FALSE;
 }
 
 //-----------------------------------------------------------------------------------------------
 //-----------------------------------------------------------------------------------------------
 
 /**
- * @brief read file into buffer.
+ * @brief read file into a new buffer, terminated with '\0'
  *
- * @param filename to be read into buffer.
- * @return true if successful, otherwise false.
+ * @param filename to be read.
+ * @param pointer to where size of file is returned.
+ * @return buffer, to be freed, if successful, otherwise NULL.
  */
-sc_bool read(const char * filename) {
+static sc_char * read_file(const char * filename, long * size) {
     FILE *file = fopen(filename, "rb");
     if (file == NULL) {
         sc_error("Error opening file: %s\n", filename);
-        return FALSE;
+        return NULL;
     }
 
     fseek(file, 0, SEEK_END);
     long file_size = ftell(file);
     rewind(file);
 
-    src_buffer = (char *)malloc(file_size + 1);
-    if (src_buffer == NULL) {
+    sc_char * buffer = (char *)malloc(file_size + 1);
+    if (buffer == NULL) {
         sc_error("Error allocating memory\n");
         fclose(file);
-        return FALSE;
+        return NULL;
     }
 
-    size_t bytes_read = fread(src_buffer, 1, file_size, file);
+    size_t bytes_read = fread(buffer, 1, file_size, file);
     if (bytes_read != file_size) {
         sc_error("Error reading file: %s\n", filename);
-        free(src_buffer);
+        free(buffer);
         fclose(file);
-        return FALSE;
+        return NULL;
     }
 
-    src_buffer[file_size] = '\0';
+    buffer[file_size] = '\0';
     fclose(file);
 
+    *size = file_size;
+    return buffer;
+}
+
+/**
+ * @brief read file into buffer.
+ *
+ * @param filename to be read into buffer.
+ * @return true if successful, otherwise false.
+ */
+sc_bool read(const char * filename) {
+    long size;
+    src_buffer = read_file(filename, &size);
+    if (src_buffer == NULL) {
+        return FALSE;
+    }
+
+    // @include is relative to this file, which is never included itself
+    sc_char real[PATH_MAX];
+    if (realpath(filename, real)) {
+        mark_included(real);
+        set_current_dir(real);
+    }
+
     return TRUE;
 }
 
@@ -774,7 +1249,7 @@ sc_bool parse_literal(sc_ushort * lit_offset, sc_uint * return_not_push) {
             value = value * -1.0f;
         }
         if (return_not_push == NULL) {
-            lo = push_literal_32( *((sc_uint*)(&value)) );
+            lo = intern_literal_32( *((sc_uint*)(&value)) );
         }
         else {
             *return_not_push = *((sc_uint*)(&value));
@@ -785,7 +1260,7 @@ sc_bool parse_literal(sc_ushort * lit_offset, sc_uint * return_not_push) {
         parse_int(digits, &value);
         value = value * -1;
         if (return_not_push == NULL) {
-            lo = push_literal_32( *((sc_uint*)(&value)) );
+            lo = intern_literal_32( *((sc_uint*)(&value)) );
         }
         else {
             *return_not_push = *((sc_uint*)(&value));
@@ -795,7 +1270,7 @@ sc_bool parse_literal(sc_ushort * lit_offset, sc_uint * return_not_push) {
         sc_uint value;
         parse_unsigned_int(digits, &value);
         if (return_not_push == NULL) {
-            lo = push_literal_32(value);
+            lo = intern_literal_32(value);
         }
         else {
             *return_not_push = value;
@@ -861,72 +1336,103 @@ sc_bool parse_string_literal(sc_ushort * lit_offset) {
 
 
 /**
- * @brief parse a label, including definition and inline
- * 
- * @param pointer to where is defined will be returned, if not null 
- * @return true if successful, otherwise false.
+ * @brief check if a macro body defines a label, i.e. has a line _name:
+ *
+ * @param body of macro
+ * @param name of label, without label_prefix
+ * @return true if defined in body, otherwise false
  */
-sc_bool parse_label(label **dst_label, sc_bool should_be_definition) {
-    // parse literal
-    strip_whitespace();
-
-    sc_char * label_start = src_buffer;
-
-    while (token != ' ' && token != 0 && token != '\n' & token != ':') {
-        if (!is_alpha(token) && !is_digit(token) && token != '_') {
-            sc_error("ERROR: line(%d) invalid label\n", line);
-            return FALSE;
+static sc_bool body_defines_label(const sc_char * body, const sc_char * name) {
+    sc_int name_length = slen(name);
+    for (const sc_char * p = body; *p;) {
+        while (*p == ' ' || *p == '\t') {
+            p++;
+        }
+        if (*p == '_' && scmp(p + 1, name, name_length) && p[1 + name_length] == ':') {
+            return TRUE;
+        }
+        while (*p != 0 && *p != '\n') {
+            p++;
+        }
+        if (*p == '\n') {
+            p++;
         }
-        token = *src_buffer++;
+    }
+    return FALSE;
+}
+
+/**
+ * @brief find or make label, as parse_label, for name without prefix
+ *
+ * @param name of label, without label_prefix
+ * @param pointer to where is defined will be returned, if not null
+ * @return true if successful, otherwise false.
+ */
+sc_bool resolve_label(const sc_char * name, sc_bool should_be_definition, label **dst_label) {
+    // in an expansion only the macro's own labels are within its prefix, any other
+    // name, e.g. an argument, is resolved where the macro is used
+    const sc_char * prefix = label_prefix;
+    sc_uint depth = macro_depth;
+    while (depth > 0 && !body_defines_label(expansion_scopes[depth - 1].body_, name)) {
+        prefix = expansion_scopes[depth - 1].prefix_;
+        depth--;
     }
 
-    sc_int prefix_length = slen(label_prefix);
-    sc_size_t label_length = prefix_length + (src_buffer-1) - label_start;
-    sc_char * lab = sc_malloc(label_length+1 * sizeof(sc_char));
+    sc_int prefix_length = slen(prefix);
+    sc_int name_length = slen(name);
+    sc_char * lab = sc_malloc((prefix_length + name_length + 1) * sizeof(sc_char));
 
-    // check if defined as top_level
-    sc_size_t label_tmp_length =  (src_buffer-1) - label_start;
-    mcopy(label_start, lab, label_tmp_length); 
-    lab[label_tmp_length] = '\0';
+    // check if defined as top_level, without a prefix that is done below, so
+    // a forward reference from top level is defined rather than returned. A
+    // macro's own label never is, as it must not bind to one that is written
+    mcopy(name, lab, name_length);
+    lab[name_length] = '\0';
     label* dst;
-    if (is_label_defined(lab, &dst)) {
+    if (depth == 0 && prefix_length > 0 && is_label_defined(lab, &dst)) {
         if (dst_label) {
             *dst_label = dst;
         }
         return TRUE;
     }
 
-    mcopy(label_prefix, lab, prefix_length);
-    mcopy(label_start, lab+prefix_length, label_length);
-    lab[label_length] = '\0';
+    mcopy(prefix, lab, prefix_length);
+    mcopy(name, lab+prefix_length, name_length);
+    lab[prefix_length + name_length] = '\0';
     
     if (should_be_definition) {
-        if (token == ':') {
-            if (is_label_defined(lab, &dst)) {
-                if (dst->offset_ != LABEL_FORWARD) {
-                    sc_error("ERROR: line(%d) duplicate label %s\n", line, lab);
-                    return FALSE;
-                }
-                dst->offset_ = instruction_count;
+        if (is_label_defined(lab, &dst)) {
+            if (dst->offset_ != LABEL_FORWARD) {
+                sc_error("ERROR: line(%d) duplicate label %s\n", line, lab);
+                return FALSE;
             }
-            else {
-                if (current_segment == SEGMENT_TEXT) {
-                    dst = make_label(lab, instruction_count);
-                }
-                else {
-                    dst = make_label(lab, literal_count);
-                }
+            // the segment it was referenced from may not be the one it is defined in
+            if (current_segment != SEGMENT_TEXT) {
+                align_literals(4);
             }
+            dst->segment_ = current_segment;
+            dst->offset_ = current_segment == SEGMENT_TEXT ? instruction_count : literal_count;
         }
         else {
-            sc_error("ERROR: line(%d) expected :\n", line);
-            return FALSE;
+            if (current_segment == SEGMENT_TEXT) {
+                dst = make_label(lab, instruction_count);
+            }
+            else {
+                // data is words, so the label must be where the first is pushed
+                align_literals(4);
+                dst = make_label(lab, literal_count);
+            }
+            if (dst == NULL) {
+                return FALSE;
+            }
         }
     }
     else {
         if (!is_label_defined(lab, &dst)) {
             // not previously defined or referenced
             dst = make_label(lab, LABEL_FORWARD);
+            if (dst == NULL) {
+                return FALSE;
+            }
         }
     }
 
@@ -938,32 +1444,79 @@ sc_bool parse_label(label **dst_label, sc_bool should_be_definition) {
 }
 
 /**
- * @brief parse instruction operand
+ * @brief parse a label, including definition and inline
  * 
- * @param pointer to where parsed operand will be placed (can be null) 
+ * @param pointer to where is defined will be returned, if not null 
  * @return true if successful, otherwise false.
  */
-sc_bool parse_operand(operand* dst_operand) {
+sc_bool parse_label(label **dst_label, sc_bool should_be_definition) {
+    // parse literal
     strip_whitespace();
-    // while (token != ' ' && token != 0 && token != '\n') {
-        if (token == 'R') {
-            // register
-            sc_char digits[MAX_DIGITS_IN_NUM];
-            sc_int count = 0;
-            token = *src_buffer++;
-
-            while (token != ' ' && token != 0 && token != '\n' && is_digit(token)) {
-                digits[count++] = token;
-                token = *src_buffer++;
-            }
 
-            if (count == 0) {
-                sc_error("ERROR: line(%d) invalid register\n", line);
-                return FALSE;
-            }
+    sc_char * label_start = src_buffer;
 
-            digits[count] = '\0';            
-            sc_uint value;
+    while (token != ' ' && token != 0 && token != '\n' & token != ':') {
+        if (!is_alpha(token) && !is_digit(token) && token != '_') {
+            sc_error("ERROR: line(%d) invalid label\n", line);
+            return FALSE;
+        }
+        token = *src_buffer++;
+    }
+
+    sc_size_t label_length =  (src_buffer-1) - label_start;
+    if (label_length >= MAX_LABEL_LENGTH) {
+        sc_error("ERROR: line(%d) label too long\n", line);
+        return FALSE;
+    }
+    sc_char name[MAX_LABEL_LENGTH];
+    mcopy(label_start, name, label_length); 
+    name[label_length] = '\0';
+
+    if (should_be_definition && token != ':' && !is_label_defined(name, NULL)) {
+        sc_error("ERROR: line(%d) expected :\n", line);
+        return FALSE;
+    }
+
+    label * dst;
+    if (!resolve_label(name, should_be_definition, &dst)) {
+        return FALSE;
+    }
+    record_label(name, should_be_definition, dst);
+
+    if (dst_label) {
+        *dst_label = dst;
+    }
+
+    return TRUE;
+}
+
+/**
+ * @brief parse instruction operand
+ * 
+ * @param pointer to where parsed operand will be placed (can be null) 
+ * @return true if successful, otherwise false.
+ */
+sc_bool parse_operand(operand* dst_operand) {
+    strip_whitespace();
+    // while (token != ' ' && token != 0 && token != '\n') {
+        if (token == 'R') {
+            // register
+            sc_char digits[MAX_DIGITS_IN_NUM];
+            sc_int count = 0;
+            token = *src_buffer++;
+
+            while (token != ' ' && token != 0 && token != '\n' && is_digit(token)) {
+                digits[count++] = token;
+                token = *src_buffer++;
+            }
+
+            if (count == 0) {
+                sc_error("ERROR: line(%d) invalid register\n", line);
+                return FALSE;
+            }
+
+            digits[count] = '\0';            
+            sc_uint value;
             parse_unsigned_int(digits, &value);
 
             if (!is_general_reg(value)) {
@@ -1006,6 +1559,7 @@ sc_bool parse_operand(operand* dst_operand) {
                 return FALSE;
             }
             
+            digits[count] = '\0';
             sc_uint value;
             parse_unsigned_int(digits, &value);
             if (reg_token == 'S') { 
@@ -1101,7 +1655,7 @@ sc_bool parse_instruction() {
     sc_int op_length = 0;
 
     token = *src_buffer++;
-    while (token != ' ' && token != 0 && token != '\n' && op_length <= MAX_OPCODE_SIZE) {
+    while (token != ' ' && token != 0 && token != '\n' && op_length < MAX_OPCODE_SIZE) {
         op[op_length++] = token;
         token = *src_buffer++;
     }
@@ -1277,13 +1831,14 @@ sc_bool parse_stream() {
         return FALSE;
     }
 
+    // bit 0 continuous, bit 1 latest only, see generator.h
     lit = get_literal(lit_continuous_offset);
-    if (lit != 0 && lit != 1) {
-        sc_error("ERROR: line(%d) unexpected continuous %d\n", line, lit);
+    if (lit < 0 || lit > 3) {
+        sc_error("ERROR: line(%d) unexpected stream flags %d\n", line, lit);
         return FALSE;        
     }
     operand continuous_operand;
-    continuous_operand.type_ = OP_Lit;
+    continuous_operand.type_ = OP_Raw;
     continuous_operand.op_.literal_ = lit;
 
     operand operands[3];
@@ -1372,6 +1927,126 @@ sc_bool parse_attach() {
     return TRUE;
 }
 
+/**
+ * @brief parse @window.
+ * 
+ * declares the range of registers, inclusive, that are saved on CALL and
+ * restored on RET for the current function, e.g. @window R0 R2
+ */
+sc_bool parse_window() {
+    if (current_func == NULL) {
+        sc_error("ERROR: line(%d) @window outside of @func\n", line);
+        return FALSE;
+    }
+
+    operand first;
+    operand last;
+    if (!parse_operand(&first) || !parse_operand(&last)) {
+        sc_error("ERROR: line(%d) expected general registers\n", line);
+        return FALSE;
+    }
+
+    if (first.type_ != OP_Reg || !is_general_reg(first.op_.operand_) || 
+        last.type_ != OP_Reg || !is_general_reg(last.op_.operand_) ||
+        last.op_.operand_ < first.op_.operand_) {
+        sc_error("ERROR: line(%d) invalid register window\n", line);
+        return FALSE;
+    }
+
+    current_func->window_base_ = first.op_.operand_;
+    current_func->window_count_ = last.op_.operand_ - first.op_.operand_ + 1;
+    record_label_use(EV_WINDOW, current_func, current_func->window_base_, current_func->window_count_);
+
+    return TRUE;
+}
+
+/**
+ * @brief bake atlas for font, unless already baked
+ *
+ * @return true if successful, otherwise false.
+ */
+sc_bool add_font_atlas(const sc_char * path, sc_uint point) {
+    for (sc_uint i = 0; i < font_atlas_count; i++) {
+        if (font_atlases[i].point_ == point && scmp(font_atlases[i].path_, path, FONT_ATLAS_MAX_PATH)) {
+            return TRUE;
+        }
+    }
+    if (font_atlas_count >= MAX_FONT_ATLASES) {
+        sc_error("ERROR: line(%d) too many fonts\n", line);
+        return FALSE;
+    }
+    if (!bake_font_atlas(path, point, &font_atlases[font_atlas_count])) {
+        sc_error("ERROR: line(%d) could not bake font\n", line);
+        return FALSE;
+    }
+    font_atlas_count++;
+    device_capabilities |= USE_FONT_ATLAS;
+
+    return TRUE;
+}
+
+/**
+ * @brief parse quoted path, as used by @font and @include
+ *
+ * @param what path is for, used in errors
+ * @param path buffer, of size bytes, for path without quotes
+ * @param pointer to where length of path is returned
+ * @return true if successful, otherwise false.
+ */
+sc_bool parse_path(const sc_char * what, sc_char * path, sc_int size, sc_int * path_length) {
+    strip_whitespace();
+    if (token != '"') {
+        sc_error("ERROR: line(%d) expected %s path\n", line, what);
+        return FALSE;
+    }
+
+    sc_int length = 0;
+    token = *src_buffer++;
+    while (token != '"' && token != 0 && token != '\n' && length < size-1) {
+        path[length++] = token;
+        token = *src_buffer++;
+    }
+    if (token != '"') {
+        sc_error("ERROR: line(%d) invalid %s path\n", line, what);
+        return FALSE;
+    }
+    path[length] = '\0';
+    token = *src_buffer++;
+
+    *path_length = length;
+    return TRUE;
+}
+
+/**
+ * @brief parse @font "path" #point
+ *
+ * the font is rasterized now, into a glyph atlas that is stored in the ROM, 
+ * and used at run time when .Screen/font loads the same path and point size
+ *
+ * @return true if successful, otherwise false.
+ */
+sc_bool parse_font() {
+    sc_char path[FONT_ATLAS_MAX_PATH];
+    sc_int path_length;
+    if (!parse_path("font", path, FONT_ATLAS_MAX_PATH, &path_length)) {
+        return FALSE;
+    }
+
+    strip_whitespace();
+    sc_uint point;
+    if (token != '#' || !parse_literal(NULL, &point) || point == 0 || point > 0xFFFF) {
+        sc_error("ERROR: line(%d) expected point size\n", line);
+        return FALSE;
+    }
+
+    if (!add_font_atlas(path, point)) {
+        return FALSE;
+    }
+    record_text(EV_FONT, path, path_length, point);
+
+    return TRUE;
+}
+
 sc_bool parse_console() {
     if (token != '/') {
         sc_error("ERROR: line(%d) expected / following device\n", line);
@@ -1383,7 +2058,7 @@ sc_bool parse_console() {
     sc_char func[MAX_DEVICE_SIZE+1];
     sc_int func_length = 0;
     token = *src_buffer++;
-    while (token != ' ' && token != 0 && token != '\n' && func_length <= MAX_DEVICE_SIZE) {
+    while (token != ' ' && token != 0 && token != '\n' && func_length < MAX_DEVICE_SIZE) {
         func[func_length++] = token;
         token = *src_buffer++;
     }
@@ -1407,6 +2082,57 @@ sc_bool parse_console() {
         instruction i = make_instruction(CONSOLE, 2, operands);
         push_instruction(i);
 
+    } else if (scmp(func, "strn", 4)) {
+        // .Console/strn Raddr Rlength, must come before str
+        operand operand_two;
+        if (!parse_operand(&operand_two)) {    
+            sc_error("ERROR: line(%d) expected operand\n", line);
+            return FALSE;
+        }
+
+        operand operand_three;
+        if (!parse_operand(&operand_three)) {    
+            sc_error("ERROR: line(%d) expected operand\n", line);
+            return FALSE;
+        }
+
+        operand operand_one;
+        operand_one.type_ = OP_Raw;
+        operand_one.op_.literal_ = CONSOLE_STRN;
+
+        operand operands[3];
+        operands[0] = operand_one;
+        operands[1] = operand_two;
+        operands[2] = operand_three;
+
+        instruction i = make_instruction(CONSOLE, 3, operands);
+        push_instruction(i);
+
+    } else if (scmp(func, "str", 3) || scmp(func, "int", 3) || scmp(func, "float", 5)) {
+        // .Console/str Raddr, .Console/int Rvalue, .Console/float Rvalue
+        operand operand_two;
+        if (!parse_operand(&operand_two)) {    
+            sc_error("ERROR: line(%d) expected operand\n", line);
+            return FALSE;
+        }
+
+        operand operand_one;
+        operand_one.type_ = OP_Raw;
+        if (scmp(func, "str", 3)) {
+            operand_one.op_.literal_ = CONSOLE_STR;
+        } else if (scmp(func, "int", 3)) {
+            operand_one.op_.literal_ = CONSOLE_INT;
+        } else {
+            operand_one.op_.literal_ = CONSOLE_FLOAT;
+        }
+
+        operand operands[3];
+        operands[0] = operand_one;
+        operands[1] = operand_two;
+
+        instruction i = make_instruction(CONSOLE, 2, operands);
+        push_instruction(i);
+
     } else {
         sc_error("ERROR: line(%d) unknown device function\n", line);
         return FALSE;
@@ -1426,13 +2152,47 @@ sc_bool parse_screen() {
     sc_char func[MAX_DEVICE_SIZE+1];
     sc_int func_length = 0;
     token = *src_buffer++;
-    while (token != ' ' && token != 0 && token != '\n' && func_length <= MAX_DEVICE_SIZE) {
+    while (token != ' ' && token != 0 && token != '\n' && func_length < MAX_DEVICE_SIZE) {
         func[func_length++] = token;
         token = *src_buffer++;
     }
     func[func_length] = '\0';
 
-    if (scmp(func, "resize", 6)) {
+    // must come before font, as only the first length characters are compared
+    if (scmp(func, "fontready", 9) || scmp(func, "imageready", 10) || scmp(func, "image", 5)) {
+        // .Screen/fontready Rstatus Rindex, .Screen/imageready Rstatus Rindex, 
+        // .Screen/image Rindex Rfilename
+        operand operand_two;
+        if (!parse_operand(&operand_two)) {    
+            sc_error("ERROR: line(%d) expected operand\n", line);
+            return FALSE;
+        }
+
+        operand operand_three;
+        if (!parse_operand(&operand_three)) {    
+            sc_error("ERROR: line(%d) expected operand\n", line);
+            return FALSE;
+        }
+
+        operand operand_one;
+        operand_one.type_ = OP_Raw;
+        if (scmp(func, "fontready", 9)) {
+            operand_one.op_.literal_ = SCREEN_FONTREADY;
+        } else if (scmp(func, "imageready", 10)) {
+            operand_one.op_.literal_ = SCREEN_IMAGEREADY;
+        } else {
+            operand_one.op_.literal_ = SCREEN_IMAGE;
+        }
+
+        operand operands[3];
+        operands[0] = operand_one;
+        operands[1] = operand_two;
+        operands[2] = operand_three;
+
+        instruction i = make_instruction(SCREEN, 3, operands);
+        push_instruction(i);
+
+    } else if (scmp(func, "resize", 6)) {
         operand operand_two;
         if (!parse_operand(&operand_two)) {    
             sc_error("ERROR: line(%d) expected operand\n", line);
@@ -1591,7 +2351,44 @@ sc_bool parse_screen() {
 
         instruction i = make_instruction(SCREEN, 3, operands);
         push_instruction(i);
-    } else if (scmp(func, "colour", 6)) {
+    } else if (scmp(func, "framebuffer", 11) || scmp(func, "indexed", 7) || 
+               scmp(func, "blit", 4) || scmp(func, "palette", 7)) {
+        // .Screen/framebuffer Raddr Rsize, .Screen/indexed Raddr Rsize, 
+        // .Screen/blit Rxy Rsize, .Screen/palette Raddr Rcount
+        operand operand_two;
+        if (!parse_operand(&operand_two)) {    
+            sc_error("ERROR: line(%d) expected operand\n", line);
+            return FALSE;
+        }
+
+        operand operand_three;
+        if (!parse_operand(&operand_three)) {    
+            sc_error("ERROR: line(%d) expected operand\n", line);
+            return FALSE;
+        }
+
+        operand operand_one;
+        operand_one.type_ = OP_Raw;
+        if (scmp(func, "blit", 4)) {
+            operand_one.op_.literal_ = SCREEN_BLIT;
+        } else if (scmp(func, "palette", 7)) {
+            operand_one.op_.literal_ = SCREEN_PALETTE;
+        } else if (scmp(func, "indexed", 7)) {
+            operand_one.op_.literal_ = SCREEN_INDEXED;
+        } else {
+            operand_one.op_.literal_ = SCREEN_FRAMEBUFFER;
+        }
+
+        operand operands[3];
+        operands[0] = operand_one;
+        operands[1] = operand_two;
+        operands[2] = operand_three;
+
+        instruction i = make_instruction(SCREEN, 3, operands);
+        push_instruction(i);
+    } else if (scmp(func, "colour", 6) || scmp(func, "retain", 6) || scmp(func, "rate", 4) || 
+               scmp(func, "draw", 4)) {
+        // .Screen/colour Rindex, .Screen/retain Rflag, .Screen/rate Rfps, .Screen/draw Rindex
         operand operand_two;
         if (!parse_operand(&operand_two)) {    
             sc_error("ERROR: line(%d) expected operand\n", line);
@@ -1600,7 +2397,15 @@ sc_bool parse_screen() {
 
         operand operand_one;
         operand_one.type_ = OP_Raw;
-        operand_one.op_.literal_ = SCREEN_COLOUR;
+        if (scmp(func, "colour", 6)) {
+            operand_one.op_.literal_ = SCREEN_COLOUR;
+        } else if (scmp(func, "retain", 6)) {
+            operand_one.op_.literal_ = SCREEN_RETAIN;
+        } else if (scmp(func, "draw", 4)) {
+            operand_one.op_.literal_ = SCREEN_DRAW;
+        } else {
+            operand_one.op_.literal_ = SCREEN_RATE;
+        }
 
         operand operands[3];
         operands[0] = operand_one;
@@ -1655,32 +2460,335 @@ sc_bool parse_screen() {
     return TRUE;
 }
 
+//-----------------------------------------------------------------------------------------------
+// Macros, see @macro
+//-----------------------------------------------------------------------------------------------
+
+// @macro NAME, then the lines up to @endmacro are its body. NAME, with up to
+// MAX_MACRO_ARGUMENTS arguments, on a line of its own is replaced by the body, with
+// %1 ... %9 replaced by the arguments. Labels defined in a body are prefixed for each
+// expansion, as for a @func, so each expansion has its own. Any other label, such as
+// one passed as an argument, is the one where the macro is used
+#define MAX_MACROS 256
+#define MAX_MACRO_ARGUMENTS 9
+
+typedef struct {
+    sc_char * name_;
+    sc_uint hash_;
+    sc_char * body_;
+    sc_uint line_;          // of first line of body
+} macro;
+
+static macro macros[MAX_MACROS];
+static sc_uint macro_count = 0;
+
+// numbers each expansion, for its label prefix
+static sc_uint macro_expansions = 0;
+
+static sc_bool is_name_char(sc_int c) {
+    return is_alpha(c) || is_digit(c) || c == '_';
+}
+
+static macro * find_macro(const sc_char * name, sc_uint length) {
+    sc_uint hash = hash_bytes((const sc_uchar*)name, length);
+    for (sc_uint i = 0; i < macro_count; i++) {
+        if (macros[i].hash_ == hash && (sc_uint)slen(macros[i].name_) == length &&
+            memcmp(macros[i].name_, name, length) == 0) {
+            return &macros[i];
+        }
+    }
+    return NULL;
+}
+
 /**
- * @brief parse input stream.
+ * @brief add macro, the same for @macro and when replayed
  *
+ * @return true if successful, otherwise false.
  */
-sc_bool parse() {
-    char *last_pos;
+static sc_bool define_macro(const sc_char * name, const sc_char * body, sc_uint length, sc_uint body_line) {
+    sc_uint name_length = slen(name);
+    if (find_macro(name, name_length)) {
+        sc_error("ERROR: line(%d) duplicate macro %s\n", line, name);
+        return FALSE;
+    }
+    if (macro_count >= MAX_MACROS) {
+        sc_error("ERROR: line(%d) too many macros, at most %d\n", line, MAX_MACROS);
+        return FALSE;
+    }
+    macro * m = &macros[macro_count++];
+    m->name_ = copy_text(name, name_length);
+    m->hash_ = hash_bytes((const sc_uchar*)name, name_length);
+    m->body_ = copy_text(body, length);
+    m->line_ = body_line;
+
+    if (is_recorded()) {
+        module_event * event = record_event(EV_MACRO);
+        event->text_ = copy_text(body, length);
+        event->text_length_ = length;
+        event->prefix_ = copy_text(name, name_length);
+        event->values_[0] = body_line;
+    }
+    return TRUE;
+}
 
-    DEBUG("begin\n");
+/**
+ * @brief parse @macro, up to and including @endmacro
+ *
+ * @return true if successful, otherwise false.
+ */
+sc_bool parse_macro() {
+    strip_whitespace();
 
-    while ((token = *src_buffer++)) {
-        //sc_print("token = %d\n", token);
-        if (token == ';') {
-            // skip comments
-            while (*src_buffer != 0 && *src_buffer != '\n') {
-                src_buffer++;
-            }
+    // named as an instruction, so it is used like one
+    sc_char name[MAX_LABEL_LENGTH];
+    sc_int name_length = 0;
+    if (!is_alpha(token)) {
+        sc_error("ERROR: line(%d) invalid macro name\n", line);
+        return FALSE;
+    }
+    while (is_name_char(token)) {
+        if (name_length == MAX_LABEL_LENGTH - 1) {
+            sc_error("ERROR: line(%d) macro name too long\n", line);
+            return FALSE;
         }
-        else if (token == '@') {
-            // toplevel construct (e.g. stream, task, etc)
-            // reset label prefix...
-            
-
-            sc_char tl[MAX_TOPLEVEL_SIZE+1];
-            sc_int tl_length = 0;
+        name[name_length++] = token;
+        token = *src_buffer++;
+    }
+    name[name_length] = '\0';
+    if (match_opcode(name, NULL) || match_datacode(name, NULL)) {
+        sc_error("ERROR: line(%d) macro %s is an instruction\n", line, name);
+        return FALSE;
+    }
+
+    strip_whitespace();
+    if (token == ';') {
+        while (*src_buffer != 0 && *src_buffer != '\n') {
+            src_buffer++;
+        }
+        token = *src_buffer++;
+    }
+    if (token != '\n') {
+        sc_error("ERROR: line(%d) expected end of line after @macro %s\n", line, name);
+        return FALSE;
+    }
+    line++;
+
+    // body is every line up to the one starting with @endmacro
+    sc_char * body = src_buffer;
+    sc_uint body_line = line;
+    sc_char * p = src_buffer;
+    for (;;) {
+        sc_char * start = p;
+        while (*p == ' ' || *p == '\t') {
+            p++;
+        }
+        if (scmp(p, "@endmacro", 9) && !is_name_char(p[9])) {
+            if (!define_macro(name, body, start - body, body_line)) {
+                return FALSE;
+            }
+            src_buffer = p + 9;
+            token = *src_buffer++;
+            return TRUE;
+        }
+        while (*p != 0 && *p != '\n') {
+            p++;
+        }
+        if (*p == 0) {
+            sc_error("ERROR: line(%d) @macro %s without @endmacro\n", body_line - 1, name);
+            return FALSE;
+        }
+        p++;
+        line++;
+    }
+}
+
+static sc_bool is_macro_use(const sc_char * start) {
+    sc_uint length = 0;
+    while (is_name_char(start[length])) {
+        length++;
+    }
+    return find_macro(start, length) != NULL;
+}
+
+/**
+ * @brief end of macro use, which is the end of its line, ignoring any comment
+ *
+ * @param start of macro name
+ * @return one past last argument
+ */
+static const sc_char * end_of_expansion(const sc_char * start) {
+    const sc_char * end = start;
+    sc_bool quoted = FALSE;
+    while (*end != 0 && *end != '\n' && (quoted || *end != ';')) {
+        if (*end == '"') {
+            quoted = !quoted;
+        }
+        end++;
+    }
+    while (end > start && (end[-1] == ' ' || end[-1] == '\t')) {
+        end--;
+    }
+    return end;
+}
+
+/**
+ * @brief copy body of macro, replacing %1 ... %9 with arguments
+ *
+ * @param dst where to copy to, or NULL to only count
+ * @return length of expansion, or -1 if an argument is missing
+ */
+static sc_int substitute(const macro * m, const sc_char ** arguments, const sc_uint * lengths,
+                         sc_uint count, sc_char * dst) {
+    sc_int length = 0;
+    for (const sc_char * p = m->body_; *p; p++) {
+        if (*p == '%' && p[1] >= '1' && p[1] <= '9') {
+            sc_uint a = p[1] - '1';
+            if (a >= count) {
+                sc_error("ERROR: line(%d) macro %s has no argument %%%d\n", line, m->name_, a + 1);
+                return -1;
+            }
+            if (dst) {
+                mcopy(arguments[a], dst + length, lengths[a]);
+            }
+            length += lengths[a];
+            p++;
+        }
+        else {
+            if (dst) {
+                dst[length] = *p;
+            }
+            length++;
+        }
+    }
+    return length;
+}
+
+/**
+ * @brief parse expansion of macro, in place of its use
+ *
+ * @param text macro name then its arguments, as written
+ * @param length of text
+ * @return true if successful, otherwise false.
+ */
+sc_bool expand_macro(const sc_char * text, sc_uint length) {
+    sc_uint name_length = 0;
+    while (name_length < length && is_name_char(text[name_length])) {
+        name_length++;
+    }
+    macro * m = find_macro(text, name_length);
+    if (m == NULL) {
+        sc_error("ERROR: line(%d) unknown macro %.*s\n", line, name_length, text);
+        return FALSE;
+    }
+    if (macro_depth >= MAX_MACRO_DEPTH) {
+        sc_error("ERROR: line(%d) macro %s nested too deeply\n", line, m->name_);
+        return FALSE;
+    }
+
+    // arguments are separated by spaces, a string may contain them
+    const sc_char * arguments[MAX_MACRO_ARGUMENTS];
+    sc_uint lengths[MAX_MACRO_ARGUMENTS];
+    sc_uint count = 0;
+    for (sc_uint i = name_length; i < length;) {
+        if (text[i] == ' ' || text[i] == '\t') {
+            i++;
+            continue;
+        }
+        if (count == MAX_MACRO_ARGUMENTS) {
+            sc_error("ERROR: line(%d) too many arguments to macro %s\n", line, m->name_);
+            return FALSE;
+        }
+        sc_uint start = i;
+        sc_bool quoted = FALSE;
+        while (i < length && (quoted || (text[i] != ' ' && text[i] != '\t'))) {
+            if (text[i] == '"') {
+                quoted = !quoted;
+            }
+            i++;
+        }
+        arguments[count] = &text[start];
+        lengths[count++] = i - start;
+    }
+
+    sc_int expansion_length = substitute(m, arguments, lengths, count, NULL);
+    if (expansion_length < 0) {
+        return FALSE;
+    }
+    sc_char * expansion = (sc_char*)malloc(expansion_length + 1);
+    substitute(m, arguments, lengths, count, expansion);
+    expansion[expansion_length] = '\0';
+
+    if (is_recorded()) {
+        module_event * event = record_event(EV_EXPAND);
+        event->text_ = copy_text(text, length);
+        event->text_length_ = length;
+        event->prefix_ = copy_text(label_prefix, slen(label_prefix));
+    }
+
+    // state of where the macro is used, its labels are within its label prefix,
+    // with a . so they are never the same as a label that is written
+    sc_char * saved_buffer = src_buffer;
+    sc_int saved_token = token;
+    sc_uint saved_line = line;
+    sc_char saved_prefix[MAX_LABEL_LENGTH];
+    mcopy(label_prefix, saved_prefix, MAX_LABEL_LENGTH);
+
+    sc_bool ok = FALSE;
+    if (snprintf(label_prefix, MAX_LABEL_LENGTH, "%s.%s%d",
+            saved_prefix, m->name_, macro_expansions++) >= MAX_LABEL_LENGTH) {
+        sc_error("ERROR: line(%d) label prefix too long\n", line);
+    }
+    else {
+        src_buffer = expansion;
+        line = m->line_;
+        // an @include within an expansion starts again at depth 0, so keep what it replaces
+        expansion_scope saved_scope = expansion_scopes[macro_depth];
+        expansion_scopes[macro_depth].body_ = m->body_;
+        expansion_scopes[macro_depth].prefix_ = saved_prefix;
+        macro_depth++;
+        ok = parse();
+        macro_depth--;
+        expansion_scopes[macro_depth] = saved_scope;
+        if (!ok) {
+            sc_error("ERROR: line(%d) in expansion of macro %s\n", saved_line, m->name_);
+        }
+    }
+    free(expansion);
+
+    src_buffer = saved_buffer;
+    token = saved_token;
+    line = saved_line;
+    mcopy(saved_prefix, label_prefix, MAX_LABEL_LENGTH);
+
+    return ok;
+}
+
+/**
+ * @brief parse input stream.
+ *
+ */
+sc_bool parse() {
+    char *last_pos;
+
+    DEBUG("begin\n");
+
+    while ((token = *src_buffer++)) {
+        //sc_print("token = %d\n", token);
+        if (token == ';') {
+            // skip comments
+            while (*src_buffer != 0 && *src_buffer != '\n') {
+                src_buffer++;
+            }
+        }
+        else if (token == '@') {
+            // toplevel construct (e.g. stream, task, etc)
+            // reset label prefix...
+            
+
+            sc_char tl[MAX_TOPLEVEL_SIZE+1];
+            sc_int tl_length = 0;
             token = *src_buffer++;
-            while (token != ' ' && token != 0 && token != '\n' && tl_length <= MAX_TOPLEVEL_SIZE) {
+            while (token != ' ' && token != 0 && token != '\n' && tl_length < MAX_TOPLEVEL_SIZE) {
                 tl[tl_length++] = token;
                 token = *src_buffer++;
             }
@@ -1694,7 +2802,7 @@ sc_bool parse() {
                 sc_char segment[MAX_TOPLEVEL_SIZE+1];
                 sc_int segment_length = 0;
                 //token = *src_buffer++;
-                while (token != ' ' && token != 0 && token != '\n' && segment_length <= MAX_TOPLEVEL_SIZE) {
+                while (token != ' ' && token != 0 && token != '\n' && segment_length < MAX_TOPLEVEL_SIZE) {
                     segment[segment_length++] = token;
                     token = *src_buffer++;
                 }
@@ -1706,15 +2814,18 @@ sc_bool parse() {
                 else if (scmp(segment, ".data", 5)) {
                     current_segment = SEGMENT_DATA;
                 }
+                record_value(EV_SEGMENT, current_segment, 0);
             }
             else if (scmp(tl, "task", 4) && current_segment != SEGMENT_NOT_SET) {
                 DEBUG("start task\n");
                 label_prefix[0] = '\0';
+                current_func = NULL;
                 label* dst_label;
                 if (parse_label(&dst_label, TRUE)) {
                     sc_int len = slen(dst_label->name_.str_);
                     mcopy(dst_label->name_.str_, label_prefix, len);
                     label_prefix[len] = '\0';
+                    push_symbol(SYM_TASK, dst_label);
                 }
                 else {
                     sc_error("ERROR: line(%d) expected label\n", line);
@@ -1729,12 +2840,26 @@ sc_bool parse() {
                     sc_int len = slen(dst_label->name_.str_);
                     mcopy(dst_label->name_.str_, label_prefix, len);
                     label_prefix[len] = '\0';
+                    current_func = dst_label;
+                    push_symbol(SYM_FUNC, dst_label);
                 }
                 else {
                     sc_error("ERROR: line(%d) expected label\n", line);
                     return FALSE;
                 }
             }
+            else if (scmp(tl, "macro", 5)) {
+                DEBUG("start macro\n");
+                if (!parse_macro()) {
+                    return FALSE;
+                }
+            }
+            else if (scmp(tl, "window", 6) && current_segment != SEGMENT_NOT_SET) {
+                DEBUG("start window\n");
+                if (!parse_window()) {
+                    return FALSE;
+                }
+            }
             else if (scmp(tl, "stream", 6) && current_segment != SEGMENT_NOT_SET) {
                 if (!parse_stream()) {
                     return FALSE;
@@ -1752,15 +2877,31 @@ sc_bool parse() {
                 instruction i = make_instruction(AWAIT, 0, NULL);
                 push_instruction(i);
             }
+            else if (scmp(tl, "include", 7)) {
+                DEBUG("start include\n");
+                sc_char name[PATH_MAX];
+                sc_int name_length;
+                if (!parse_path("include", name, PATH_MAX, &name_length) || !include_file(name)) {
+                    return FALSE;
+                }
+            }
+            else if (scmp(tl, "font", 4)) {
+                DEBUG("start font\n");
+                if (!parse_font()) {
+                    return FALSE;
+                }
+            }
             else if (scmp(tl, "entry", 4) && current_segment != SEGMENT_NOT_SET) {
                 // TODO: should we set prefix????
                 label_prefix[0] = '\0'; 
+                current_func = NULL;
                 // check that there is only one entry !!
                 if (entry_point != ENTRY_NOTDEFINED) {
                     sc_error("ERROR: line(%d) multiple entry points\n", line);
                     return FALSE;
                 }
                 entry_point = instruction_count;
+                record_value(EV_ENTRY, 0, 0);
             }
             else {
                 sc_error("ERROR: line(%d) unknown toplevel definition\n", line);
@@ -1772,7 +2913,7 @@ sc_bool parse() {
             sc_char dev[MAX_DEVICE_SIZE+1];
             sc_int dev_length = 0;
             token = *src_buffer++;
-            while (token != ' ' && token != 0 && token != '/' && token != '\n' && dev_length <= MAX_DEVICE_SIZE) {
+            while (token != ' ' && token != 0 && token != '/' && token != '\n' && dev_length < MAX_DEVICE_SIZE) {
                 dev[dev_length++] = token;
                 token = *src_buffer++;
             }
@@ -1805,6 +2946,18 @@ sc_bool parse() {
             // parse label definition
             parse_label(NULL, TRUE);
         }
+        else if (is_alpha(token) && is_macro_use(src_buffer - 1)) {
+            DEBUG("start expansion\n");
+            sc_char * start = src_buffer - 1;
+            if (!expand_macro(start, end_of_expansion(start) - start)) {
+                return FALSE;
+            }
+            // the rest of the line, if anything, is a comment
+            while (*src_buffer != 0 && *src_buffer != '\n') {
+                src_buffer++;
+            }
+            token = *src_buffer++;
+        }
         else if (is_alpha(token)) {
             DEBUG("start mnemoic\n");
             // parse mnemonic
@@ -1820,6 +2973,10 @@ sc_bool parse() {
             // process line
             line++;
         }
+        else if (token == 0) {
+            // last line had no newline, and its end has been consumed
+            break;
+        }
     }
 
     DEBUG("end\n");
@@ -1828,115 +2985,1381 @@ sc_bool parse() {
 }
 
 //-----------------------------------------------------------------------------------------------
+// @include and the module cache
 //-----------------------------------------------------------------------------------------------
 
-typedef struct {
-    sc_uint magic_;
-    sc_uint capabilities_;
-    sc_ushort entry_point_;
-    sc_uint literals_start_;
-    sc_ushort literals_length_;
-    sc_uint code_start_;
-    sc_ushort code_length_;
-} header ;
+// cache file, magic, version, event count, then for each event its fields and text
+#define MODULE_CACHE_MAGIC 0x53434D44   // "SCMD"
+#define MODULE_CACHE_VERSION 2
 
-sc_bool emit(const char* filename) {
-    FILE *file = fopen(filename, "wb");
-    if (file == NULL) {
-        sc_error("ERROR: could not opening file %s\n", filename);
-        return FALSE;
+/**
+ * @brief find file to include, relative to the including file, then each -I path
+ *
+ * @param name as written in @include
+ * @param buffer of PATH_MAX bytes, for real path of file
+ * @return true if found, otherwise false
+ */
+static sc_bool find_include(const sc_char * name, sc_char * real) {
+    if (name[0] == '/') {
+        return realpath(name, real) != NULL;
     }
 
-    sc_uint lit_bytes = literal_count * sizeof(sc_int);
-    sc_uint code_bytes = instruction_count * sizeof(sc_int);
-    header my_header = {
-        .magic_ = 0xDEADBEEF,
-        .capabilities_ = device_capabilities,
-        .entry_point_ = (sc_ushort)entry_point,
-        .literals_start_ = sizeof(header),
-        .literals_length_ = lit_bytes, // in bytes
-        .code_start_ = sizeof(header) + lit_bytes,
-        .code_length_ = code_bytes,
-    };
-
-    sc_print("sc = %d %d\n", literal_count, instruction_count);
-
-    print_instructions();
-
-    size_t bytes_written = fwrite(&my_header, sizeof(header), 1, file);
-    if (bytes_written != 1) {
-        sc_error("Error writing to file\n");
-        fclose(file);
-        return FALSE;
+    // a path too long to hold is skipped, rather than truncated to some other file
+    sc_char path[PATH_MAX];
+    if (snprintf(path, PATH_MAX, "%s/%s", current_dir, name) < PATH_MAX &&
+        realpath(path, real)) {
+        return TRUE;
     }
-
-    bytes_written = fwrite(literals, 1, lit_bytes, file);
-    if (bytes_written != lit_bytes) {
-        sc_error("Error writing data to file\n");
-        fclose(file);
-        return FALSE;
+    for (sc_uint i = 0; i < include_path_count; i++) {
+        if (snprintf(path, PATH_MAX, "%s/%s", include_paths[i], name) < PATH_MAX &&
+            realpath(path, real)) {
+            return TRUE;
+        }
     }
+    return FALSE;
+}
 
-    // encode and write each instruction
-    for (int i = 0; i < instruction_count; i++) {
-        sc_uint ei = encode_instruction(instructions[i]);
-        bytes_written = fwrite(&ei, 1, 4, file);
-        if (bytes_written != sizeof(sc_uint)) {
-            sc_error("Error writing instruction data to file %zu\n", bytes_written);
-            fclose(file);
-            return FALSE;
-        }
+static unsigned long long module_key(const sc_char * buffer, long size, sc_uint segment) {
+    // FNV-1a, 64-bit
+    unsigned long long hash = 14695981039346656037ULL;
+    for (long i = 0; i < size; i++) {
+        hash ^= (sc_uchar)buffer[i];
+        hash *= 1099511628211ULL;
     }
+    // which toplevel definitions are allowed depends on the segment a module starts in
+    hash ^= segment;
+    hash *= 1099511628211ULL;
+    return hash;
+}
 
-    fclose(file);
+static void delete_module_log(module_log * log) {
+    for (sc_uint i = 0; i < log->count_; i++) {
+        free(log->events_[i].text_);
+        free(log->events_[i].prefix_);
+    }
+    free(log->events_);
+}
 
-    return TRUE;
+static sc_bool put(FILE * file, const void * data, size_t bytes) {
+    // data is NULL for events without text
+    return bytes == 0 || fwrite(data, 1, bytes, file) == bytes;
 }
 
-//-----------------------------------------------------------------------------------------------
-//-----------------------------------------------------------------------------------------------
+static sc_bool get(FILE * file, void * data, size_t bytes) {
+    return fread(data, 1, bytes, file) == bytes;
+}
 
-sc_bool dis(char* filename) {
-    FILE *file = fopen(filename, "rb");
+static sc_bool write_module(const sc_char * path, const module_log * log) {
+    // written to the side and renamed, so a cache entry is never seen half written
+    sc_char tmp[PATH_MAX];
+    if (snprintf(tmp, PATH_MAX, "%s.tmp", path) >= PATH_MAX) {
+        return FALSE;
+    }
+    FILE * file = fopen(tmp, "wb");
     if (file == NULL) {
-        sc_error("Error opening file %s\n", filename);
         return FALSE;
     }
 
-    header header_data;
-
-    if (fread(&header_data, sizeof(header), 1, file) != 1) {
-        sc_error("Error reading header from file\n");
+    sc_uint header[3] = { MODULE_CACHE_MAGIC, MODULE_CACHE_VERSION, log->count_ };
+    sc_bool ok = put(file, header, sizeof(header));
+    for (sc_uint i = 0; i < log->count_ && ok; i++) {
+        const module_event * event = &log->events_[i];
+        sc_uint prefix_length = event->prefix_ ? slen(event->prefix_) : 0;
+        ok = put(file, &event->kind_, sizeof(event->kind_)) &&
+             put(file, event->values_, sizeof(event->values_)) &&
+             put(file, event->types_, sizeof(event->types_)) &&
+             put(file, event->operands_, sizeof(event->operands_)) &&
+             put(file, &event->text_length_, sizeof(event->text_length_)) &&
+             put(file, event->text_, event->text_length_) &&
+             put(file, &prefix_length, sizeof(prefix_length)) &&
+             put(file, event->prefix_, prefix_length);
+    }
+    ok = fclose(file) == 0 && ok;
+    if (!ok || rename(tmp, path) != 0) {
+        remove(tmp);
         return FALSE;
     }
+    return TRUE;
+}
 
-    fseek(file, header_data.literals_start_, SEEK_SET);
-    size_t bytes_read = fread(literals, 1, header_data.literals_length_, file);
-    if (bytes_read != header_data.literals_length_) {
-        sc_error("Error reading literals from file\n");
-        return FALSE;
+static sc_char * get_text(FILE * file, sc_uint length) {
+    if (length >= PATH_MAX * 16) {
+        return NULL;
     }
-    literal_count = header_data.literals_length_ / 4;
+    sc_char * text = (sc_char*)malloc(length + 1);
+    if (!get(file, text, length)) {
+        free(text);
+        return NULL;
+    }
+    text[length] = '\0';
+    return text;
+}
 
-    sc_uint* encoded_instructions = (sc_uint*)malloc(header_data.code_length_);
-    fseek(file, header_data.code_start_, SEEK_SET);
-    bytes_read = fread(encoded_instructions, 1, header_data.code_length_, file);
-    if (bytes_read != header_data.code_length_) {
-        sc_error("Error reading code from file\n");
-        return FALSE;
+/**
+ * @brief check event only refers to events before it, of the right kind
+ */
+static sc_bool valid_event(const module_log * log, sc_uint index) {
+    const module_event * event = &log->events_[index];
+    if (event->kind_ == EV_INSTRUCTION) {
+        if (event->values_[1] > 3) {
+            return FALSE;
+        }
+        for (sc_uint o = 0; o < event->values_[1]; o++) {
+            sc_uint ref = event->operands_[o];
+            if (event->types_[o] == OP_Label &&
+                (ref >= index || log->events_[ref].kind_ != EV_LABEL)) {
+                return FALSE;
+            }
+            if (event->types_[o] == OP_Lit &&
+                (ref >= index || log->events_[ref].kind_ < EV_LITERAL_32 || log->events_[ref].kind_ > EV_STRING)) {
+                return FALSE;
+            }
+        }
+    }
+    else if (event->kind_ == EV_SYMBOL || event->kind_ == EV_WINDOW) {
+        sc_uint ref = event->values_[0];
+        return ref < index && log->events_[ref].kind_ == EV_LABEL;
     }
+    return event->kind_ <= EV_EXPAND;
+}
 
-    instruction_count = header_data.code_length_ / 4;
-    entry_point = header_data.entry_point_;
+static sc_bool read_module(const sc_char * path, module_log * log) {
+    FILE * file = fopen(path, "rb");
+    if (file == NULL) {
+        return FALSE;
+    }
 
-    //sc_print("sc = %d %d\n", literal_count, instruction_count);
+    sc_uint header[3];
+    sc_bool ok = get(file, header, sizeof(header)) &&
+                 header[0] == MODULE_CACHE_MAGIC && header[1] == MODULE_CACHE_VERSION;
+    if (ok) {
+        log->count_ = 0;
+        log->capacity_ = header[2];
+        log->events_ = (module_event*)calloc(header[2] ? header[2] : 1, sizeof(module_event));
+    }
+    for (sc_uint i = 0; ok && i < header[2]; i++) {
+        module_event * event = &log->events_[log->count_++];
+        sc_uint prefix_length;
+        ok = get(file, &event->kind_, sizeof(event->kind_)) &&
+             get(file, event->values_, sizeof(event->values_)) &&
+             get(file, event->types_, sizeof(event->types_)) &&
+             get(file, event->operands_, sizeof(event->operands_)) &&
+             get(file, &event->text_length_, sizeof(event->text_length_)) &&
+             (event->text_ = get_text(file, event->text_length_)) != NULL &&
+             get(file, &prefix_length, sizeof(prefix_length)) &&
+             prefix_length < MAX_LABEL_LENGTH &&
+             (event->prefix_ = get_text(file, prefix_length)) != NULL &&
+             valid_event(log, i);
+    }
+    fclose(file);
 
-    // display capabilities
-    if (header_data.capabilities_ & USE_DEVICE_CONSOLE) {
-        sc_print("device .Console\n");
+    if (!ok) {
+        delete_module_log(log);
+        memset(log, 0, sizeof(module_log));
     }
-    if (header_data.capabilities_ & USE_DEVICE_SCREEN) {
-        sc_print("requires device .Screen\n");
+    return ok;
+}
+
+/**
+ * @brief add to program what a module added when it was parsed
+ *
+ * @return true if successful, otherwise false.
+ */
+static sc_bool replay_module(module_log * log) {
+    for (sc_uint i = 0; i < log->count_; i++) {
+        module_event * event = &log->events_[i];
+        switch (event->kind_) {
+            case EV_INSTRUCTION: {
+                operand operands[3];
+                for (sc_uint o = 0; o < event->values_[1]; o++) {
+                    operands[o].type_ = event->types_[o];
+                    if (event->types_[o] == OP_Label) {
+                        operands[o].op_.label_ = log->events_[event->operands_[o]].label_;
+                    }
+                    else if (event->types_[o] == OP_Lit) {
+                        operands[o].op_.literal_ = log->events_[event->operands_[o]].offset_;
+                    }
+                    else if (event->types_[o] == OP_Reg) {
+                        operands[o].op_.operand_ = event->operands_[o];
+                    }
+                    else {
+                        operands[o].op_.literal_ = event->operands_[o];
+                    }
+                }
+                push_instruction(make_instruction(event->values_[0], event->values_[1], operands));
+                break;
+            }
+            case EV_LABEL: {
+                sc_int length = slen(event->prefix_);
+                mcopy(event->prefix_, label_prefix, length);
+                label_prefix[length] = '\0';
+                if (!resolve_label(event->text_, event->values_[0], &event->label_)) {
+                    return FALSE;
+                }
+                break;
+            }
+            case EV_LITERAL_32: {
+                event->offset_ = push_literal_32(event->values_[0]);
+                break;
+            }
+            case EV_LITERAL_16: {
+                event->offset_ = push_literal_16(event->values_[0]);
+                break;
+            }
+            case EV_LITERAL_8: {
+                event->offset_ = push_literal_8(event->values_[0]);
+                break;
+            }
+            case EV_CONSTANT_32: {
+                event->offset_ = intern_literal_32(event->values_[0]);
+                break;
+            }
+            case EV_STRING: {
+                event->offset_ = push_string_literal(event->text_, event->text_length_);
+                break;
+            }
+            case EV_SYMBOL: {
+                push_symbol(event->values_[1], log->events_[event->values_[0]].label_);
+                break;
+            }
+            case EV_WINDOW: {
+                label * func = log->events_[event->values_[0]].label_;
+                func->window_base_ = event->values_[1];
+                func->window_count_ = event->values_[2];
+                break;
+            }
+            case EV_ENTRY: {
+                if (entry_point != ENTRY_NOTDEFINED) {
+                    sc_error("ERROR: multiple entry points\n");
+                    return FALSE;
+                }
+                entry_point = instruction_count;
+                break;
+            }
+            case EV_SEGMENT: {
+                current_segment = event->values_[0];
+                break;
+            }
+            case EV_CAPABILITIES: {
+                device_capabilities |= event->values_[0];
+                break;
+            }
+            case EV_FONT: {
+                if (!add_font_atlas(event->text_, event->values_[0])) {
+                    return FALSE;
+                }
+                break;
+            }
+            case EV_INCLUDE: {
+                if (!include_file(event->text_)) {
+                    return FALSE;
+                }
+                break;
+            }
+            case EV_MACRO: {
+                if (!define_macro(event->prefix_, event->text_, event->text_length_, event->values_[0])) {
+                    return FALSE;
+                }
+                break;
+            }
+            case EV_EXPAND: {
+                sc_int length = slen(event->prefix_);
+                mcopy(event->prefix_, label_prefix, length);
+                label_prefix[length] = '\0';
+                if (!expand_macro(event->text_, event->text_length_)) {
+                    return FALSE;
+                }
+                break;
+            }
+        }
+    }
+    return TRUE;
+}
+
+/**
+ * @brief parse file named by @include, or replay it from the module cache
+ *
+ * a file is only included once, however many times it is named. the including 
+ * file's label prefix, function, and segment are restored once it is done
+ *
+ * @param name as written in @include
+ * @return true if successful, otherwise false.
+ */
+sc_bool include_file(const sc_char * name) {
+    record_text(EV_INCLUDE, name, slen(name), 0);
+
+    sc_char real[PATH_MAX];
+    if (!find_include(name, real)) {
+        sc_error("ERROR: line(%d) could not find include %s\n", line, name);
+        return FALSE;
+    }
+    if (!mark_included(real)) {
+        return TRUE;
+    }
+
+    long size;
+    sc_char * buffer = read_file(real, &size);
+    if (buffer == NULL) {
+        return FALSE;
+    }
+
+    // state of including file
+    sc_char * saved_buffer = src_buffer;
+    sc_int saved_token = token;
+    sc_uint saved_line = line;
+    sc_char saved_prefix[MAX_LABEL_LENGTH];
+    mcopy(label_prefix, saved_prefix, MAX_LABEL_LENGTH);
+    label * saved_func = current_func;
+    sc_uint saved_segment = current_segment;
+    sc_uint saved_capabilities = device_capabilities;
+    sc_char saved_dir[PATH_MAX];
+    mcopy(current_dir, saved_dir, PATH_MAX);
+    module_log * saved_recording = recording;
+    sc_uint saved_depth = macro_depth;
+
+    set_current_dir(real);
+    label_prefix[0] = '\0';
+    current_func = NULL;
+    device_capabilities = 0;
+    recording = NULL;
+    macro_depth = 0;
+
+    sc_bool ok;
+    module_log log = { NULL, 0, 0, TRUE };
+    sc_char cache_path[PATH_MAX];
+    // module is not cached if the cache path is too long to hold
+    sc_bool cached = module_cache &&
+        snprintf(cache_path, PATH_MAX, "%s/%016llx.scmod",
+            module_cache, module_key(buffer, size, current_segment)) < PATH_MAX;
+
+    if (cached && read_module(cache_path, &log)) {
+        DEBUG("replay include\n");
+        ok = replay_module(&log);
+        if (!ok) {
+            sc_error("ERROR: in %s, cached as %s\n", real, cache_path);
+        }
+    }
+    else {
+        if (cached) {
+            log.valid_ = TRUE;
+            recording = &log;
+        }
+        src_buffer = buffer;
+        line = 1;
+        ok = parse();
+        if (!ok) {
+            sc_error("ERROR: in %s\n", real);
+        }
+        else if (recording && log.valid_) {
+            record_value(EV_CAPABILITIES, device_capabilities, 0);
+            if (!write_module(cache_path, &log)) {
+                sc_error("WARNING: could not write module cache %s\n", cache_path);
+            }
+        }
+        recording = NULL;
+    }
+    delete_module_log(&log);
+    free(buffer);
+
+    src_buffer = saved_buffer;
+    token = saved_token;
+    line = saved_line;
+    mcopy(saved_prefix, label_prefix, MAX_LABEL_LENGTH);
+    current_func = saved_func;
+    current_segment = saved_segment;
+    device_capabilities |= saved_capabilities;
+    mcopy(saved_dir, current_dir, PATH_MAX);
+    recording = saved_recording;
+    macro_depth = saved_depth;
+
+    return ok;
+}
+
+//-----------------------------------------------------------------------------------------------
+// Optimizer, see scasm -O
+//-----------------------------------------------------------------------------------------------
+
+// what is known about a register, within a basic block
+enum { KNOWN_NOTHING, KNOWN_ADDRESS, KNOWN_LOADED };
+
+typedef struct {
+    sc_uint reloads_;
+    sc_uint self_moves_;
+    sc_uint jumps_to_jumps_;
+    sc_uint tail_calls_;
+    sc_uint unreachable_;
+    sc_uint jumps_to_next_;
+    sc_uint inlined_;
+} optimize_report;
+
+// most instructions, before its RET, of a @func that is inlined
+#define MAX_INLINE_LENGTH 8
+
+static sc_bool removed[MAX_INSRUCTIONS];
+static sc_bool leaders[MAX_INSRUCTIONS + 1];
+static sc_uint new_offsets[MAX_INSRUCTIONS + 1];
+// instructions as rewritten by inline_calls and layout
+static instruction rewritten[MAX_INSRUCTIONS];
+
+static sc_bool is_code_label(const label * lab) {
+    return lab->segment_ == SEGMENT_TEXT && lab->offset_ != LABEL_FORWARD;
+}
+
+static sc_bool is_jump_to_label(const instruction * i) {
+    return (i->opcode_ == JMP || i->opcode_ == JMPZ || i->opcode_ == JMPNZ) &&
+           i->operands_[0].type_ == OP_Label && is_code_label(i->operands_[0].op_.label_);
+}
+
+/**
+ * @brief mark instructions that may be jumped, called, or spawned to
+ *
+ * any instruction with a code label is a leader, whether or not the label is 
+ * used, as a label's address can be taken with MOVL and jumped to from a register
+ */
+static void find_leaders() {
+    memset(leaders, 0, (instruction_count + 1) * sizeof(sc_bool));
+    for (sc_uint l = 0; l < label_count; l++) {
+        if (is_code_label(&labels[l]) && labels[l].offset_ <= instruction_count) {
+            leaders[labels[l].offset_] = TRUE;
+        }
+    }
+    if (entry_point != ENTRY_NOTDEFINED) {
+        leaders[entry_point] = TRUE;
+    }
+}
+
+/**
+ * @brief drop removed instructions, moving code labels and entry point to match
+ */
+static void compact_instructions() {
+    sc_uint count = 0;
+    for (sc_uint i = 0; i < instruction_count; i++) {
+        new_offsets[i] = count;
+        if (!removed[i]) {
+            instructions[count++] = instructions[i];
+        }
+    }
+    new_offsets[instruction_count] = count;
+
+    for (sc_uint l = 0; l < label_count; l++) {
+        if (is_code_label(&labels[l]) && labels[l].offset_ <= instruction_count) {
+            labels[l].offset_ = new_offsets[labels[l].offset_];
+        }
+    }
+    if (entry_point != ENTRY_NOTDEFINED) {
+        entry_point = new_offsets[entry_point];
+    }
+
+    instruction_count = count;
+    memset(removed, 0, instruction_count * sizeof(sc_bool));
+}
+
+/**
+ * @brief @func the instruction is in, NULL if in a @task or neither
+ */
+static label * enclosing_func(sc_uint offset) {
+    symbol * enclosing = NULL;
+    for (sc_uint s = 0; s < symbol_count; s++) {
+        label * lab = symbols[s].label_;
+        if (is_code_label(lab) && lab->offset_ <= offset &&
+            (enclosing == NULL || lab->offset_ >= enclosing->label_->offset_)) {
+            enclosing = &symbols[s];
+        }
+    }
+    return enclosing && enclosing->kind_ == SYM_FUNC ? enclosing->label_ : NULL;
+}
+
+/**
+ * @brief forget what is known about registers that instruction may write
+ */
+static void forget_written(const instruction * i, sc_uint * known) {
+    switch (i->opcode_) {
+        // write no registers
+        case SWRITE: case JMP: case JMPZ: case JMPNZ: case NOP: case CMP: case CMPLT:
+        case PUSH: case SETSF: case SETSC: {
+            return;
+        }
+        // write memory, so anything loaded may have changed
+        case STR: case STRB: case STRH: {
+            for (sc_uint r = 0; r <= MAX_REGISTER_NUM; r++) {
+                if (known[r] == KNOWN_LOADED) {
+                    known[r] = KNOWN_NOTHING;
+                }
+            }
+            return;
+        }
+        // write only the first operand
+        case MOV: case MOVL: case SREAD: case ADD: case SUB: case MUL: case FTOI:
+        case ADDF: case SUBF: case MULF: case ITOF: case SHIFTR: case SHIFTL: 
+        case AND: case OR: case XOR: case POP: case LDR: case LDRB: case LDRSB: {
+            if (i->operands_[0].type_ == OP_Reg) {
+                known[i->operands_[0].op_.operand_] = KNOWN_NOTHING;
+            }
+            return;
+        }
+        // calls, devices, and the scheduler may change anything
+        default: {
+            memset(known, 0, (MAX_REGISTER_NUM + 1) * sizeof(sc_uint));
+            return;
+        }
+    }
+}
+
+/**
+ * @brief address MOVL loads, literals and labels kept apart, false if not an address
+ */
+static sc_bool address_of(const operand * op, sc_uint * address) {
+    if (op->type_ == OP_Lit) {
+        *address = op->op_.literal_;
+        return TRUE;
+    }
+    if (op->type_ == OP_Label) {
+        *address = 0x10000 + (op->op_.label_ - labels);
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/**
+ * @brief remove MOVL Rx a and MOVL Rx a, LDR Rx Rx, when Rx already holds the same,
+ * where a is a literal, e.g. #1, or a label
+ */
+static sc_bool remove_reloads(optimize_report * report) {
+    sc_uint known[MAX_REGISTER_NUM + 1];
+    sc_uint address[MAX_REGISTER_NUM + 1];
+    sc_bool changed = FALSE;
+
+    memset(known, 0, sizeof(known));
+    for (sc_uint i = 0; i < instruction_count; i++) {
+        if (leaders[i]) {
+            memset(known, 0, sizeof(known));
+        }
+        instruction * inst = &instructions[i];
+        operand * ops = inst->operands_;
+
+        sc_uint a;
+        if (inst->opcode_ == MOVL && ops[0].type_ == OP_Reg && address_of(&ops[1], &a)) {
+            sc_uint r = ops[0].op_.operand_;
+            instruction * next = i + 1 < instruction_count && !leaders[i + 1] ? &instructions[i + 1] : NULL;
+            if (known[r] == KNOWN_ADDRESS && address[r] == a) {
+                removed[i] = TRUE;
+                report->reloads_++;
+                changed = TRUE;
+                continue;
+            }
+            if (next && next->opcode_ == LDR && 
+                next->operands_[0].type_ == OP_Reg && next->operands_[0].op_.operand_ == r && 
+                next->operands_[1].type_ == OP_Reg && next->operands_[1].op_.operand_ == r && 
+                known[r] == KNOWN_LOADED && address[r] == a) {
+                removed[i] = removed[i + 1] = TRUE;
+                report->reloads_++;
+                changed = TRUE;
+                i++;
+                continue;
+            }
+            known[r] = KNOWN_ADDRESS;
+            address[r] = a;
+        }
+        else if (inst->opcode_ == LDR && ops[0].type_ == OP_Reg && ops[1].type_ == OP_Reg) {
+            sc_uint r = ops[0].op_.operand_;
+            sc_uint from = ops[1].op_.operand_;
+            if (known[from] == KNOWN_ADDRESS) {
+                known[r] = KNOWN_LOADED;
+                address[r] = address[from];
+            }
+            else {
+                known[r] = KNOWN_NOTHING;
+            }
+        }
+        else if (inst->opcode_ == MOV && ops[0].type_ == OP_Reg && ops[1].type_ == OP_Reg) {
+            known[ops[0].op_.operand_] = known[ops[1].op_.operand_];
+            address[ops[0].op_.operand_] = address[ops[1].op_.operand_];
+        }
+        else {
+            forget_written(inst, known);
+        }
+    }
+    return changed;
+}
+
+static sc_bool remove_self_moves(optimize_report * report) {
+    sc_bool changed = FALSE;
+    for (sc_uint i = 0; i < instruction_count; i++) {
+        operand * ops = instructions[i].operands_;
+        if (instructions[i].opcode_ == MOV && ops[0].type_ == OP_Reg && ops[1].type_ == OP_Reg &&
+            ops[0].op_.operand_ == ops[1].op_.operand_) {
+            removed[i] = TRUE;
+            report->self_moves_++;
+            changed = TRUE;
+        }
+    }
+    return changed;
+}
+
+/**
+ * @brief jump straight to where a chain of JMPs ends
+ */
+static sc_bool thread_jumps(optimize_report * report) {
+    sc_bool changed = FALSE;
+    for (sc_uint i = 0; i < instruction_count; i++) {
+        if (!is_jump_to_label(&instructions[i])) {
+            continue;
+        }
+        label * target = instructions[i].operands_[0].op_.label_;
+        // bounded, as the chain may be a loop
+        for (sc_uint hops = 0; hops < 16 && target->offset_ < instruction_count; hops++) {
+            instruction * next = &instructions[target->offset_];
+            if (next->opcode_ != JMP || !is_jump_to_label(next) || next->operands_[0].op_.label_ == target) {
+                break;
+            }
+            target = next->operands_[0].op_.label_;
+        }
+        if (target != instructions[i].operands_[0].op_.label_) {
+            instructions[i].operands_[0].op_.label_ = target;
+            report->jumps_to_jumps_++;
+            changed = TRUE;
+        }
+    }
+    return changed;
+}
+
+/**
+ * @brief CALL _f, RET to JMP _f, when _f's RET restores the same registers
+ */
+static sc_bool make_tail_calls(optimize_report * report) {
+    sc_bool changed = FALSE;
+    for (sc_uint i = 0; i + 1 < instruction_count; i++) {
+        instruction * inst = &instructions[i];
+        if (inst->opcode_ != CALL || instructions[i + 1].opcode_ != RET ||
+            inst->operands_[0].type_ != OP_Label || !is_code_label(inst->operands_[0].op_.label_)) {
+            continue;
+        }
+        // the callee's window is restored by its RET when called, but not when
+        // jumped to, so it must be empty or within the caller's own window
+        label * callee = inst->operands_[0].op_.label_;
+        label * caller = enclosing_func(i);
+        if (caller == NULL) {
+            continue;
+        }
+        if (callee->window_count_ > 0 &&
+            (callee->window_base_ < caller->window_base_ ||
+             callee->window_base_ + callee->window_count_ > caller->window_base_ + caller->window_count_)) {
+            continue;
+        }
+        inst->opcode_ = JMP;
+        inst->operand_count_ = 1;
+        report->tail_calls_++;
+        changed = TRUE;
+    }
+    return changed;
+}
+
+/**
+ * @brief remove instructions that follow JMP, RET, or HALT, up to the next leader
+ */
+static sc_bool remove_unreachable(optimize_report * report) {
+    sc_bool changed = FALSE;
+    sc_bool reachable = TRUE;
+    for (sc_uint i = 0; i < instruction_count; i++) {
+        if (leaders[i]) {
+            reachable = TRUE;
+        }
+        if (!reachable && !removed[i]) {
+            removed[i] = TRUE;
+            report->unreachable_++;
+            changed = TRUE;
+        }
+        sc_int opcode = instructions[i].opcode_;
+        if (opcode == JMP || opcode == RET || opcode == HALT) {
+            reachable = FALSE;
+        }
+    }
+    return changed;
+}
+
+static sc_bool remove_jumps_to_next(optimize_report * report) {
+    sc_bool changed = FALSE;
+    for (sc_uint i = 0; i < instruction_count; i++) {
+        if (instructions[i].opcode_ == JMP && is_jump_to_label(&instructions[i]) &&
+            instructions[i].operands_[0].op_.label_->offset_ == i + 1) {
+            removed[i] = TRUE;
+            report->jumps_to_next_++;
+            changed = TRUE;
+        }
+    }
+    return changed;
+}
+
+/**
+ * @brief number of instructions before RET of @func _f, if CALL _f can be replaced 
+ * by them, otherwise -1
+ *
+ * _f must be a leaf, with nothing jumped to within it, and when it has a window it
+ * must not write the registers in it, as there is then no RET to restore them
+ */
+static sc_int inline_length(const label * callee) {
+    sc_bool is_func = FALSE;
+    for (sc_uint s = 0; s < symbol_count; s++) {
+        if (symbols[s].label_ == callee && symbols[s].kind_ == SYM_FUNC) {
+            is_func = TRUE;
+        }
+    }
+    if (!is_func || !is_code_label(callee)) {
+        return -1;
+    }
+
+    sc_uint known[MAX_REGISTER_NUM + 1];
+    sc_uint start = callee->offset_;
+    for (sc_uint i = start; i < instruction_count && i <= start + MAX_INLINE_LENGTH; i++) {
+        if (i > start && leaders[i]) {
+            return -1;
+        }
+        const instruction * inst = &instructions[i];
+        switch (inst->opcode_) {
+            case RET: {
+                return i - start;
+            }
+            case JMP: case JMPZ: case JMPNZ: case CALL: case HALT:
+            case SPAWN: case YIELD: case START: case AWAIT: {
+                return -1;
+            }
+        }
+        if (callee->window_count_ > 0) {
+            // anything forgotten is written
+            for (sc_uint r = 0; r <= MAX_REGISTER_NUM; r++) {
+                known[r] = KNOWN_ADDRESS;
+            }
+            forget_written(inst, known);
+            for (sc_uint w = 0; w < callee->window_count_; w++) {
+                if (known[callee->window_base_ + w] == KNOWN_NOTHING) {
+                    return -1;
+                }
+            }
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief replace CALL _f with _f's instructions, when _f is small, see inline_length
+ *
+ * _f is kept, as it may still be called from elsewhere, or by address. code labels 
+ * are encoded in 8 bits, so none below 256 is moved past it
+ */
+static void inline_calls(optimize_report * report) {
+    sc_int room = 255;
+    for (sc_uint l = 0; l < label_count; l++) {
+        if (is_code_label(&labels[l]) && labels[l].offset_ <= 255 && 255 - labels[l].offset_ < room) {
+            room = 255 - labels[l].offset_;
+        }
+    }
+    if (entry_point != ENTRY_NOTDEFINED && entry_point <= 255 && 255 - entry_point < room) {
+        room = 255 - entry_point;
+    }
+
+    sc_uint count = 0;
+    for (sc_uint i = 0; i < instruction_count; i++) {
+        new_offsets[i] = count;
+        const instruction * inst = &instructions[i];
+        if (inst->opcode_ == CALL && inst->operands_[0].type_ == OP_Label) {
+            sc_int length = inline_length(inst->operands_[0].op_.label_);
+            if (length >= 0 && length - 1 <= room &&
+                count + length + (instruction_count - i - 1) <= MAX_INSRUCTIONS) {
+                sc_uint start = inst->operands_[0].op_.label_->offset_;
+                for (sc_int b = 0; b < length; b++) {
+                    rewritten[count++] = instructions[start + b];
+                }
+                room -= length - 1;
+                report->inlined_++;
+                continue;
+            }
+        }
+        rewritten[count++] = *inst;
+    }
+    new_offsets[instruction_count] = count;
+
+    for (sc_uint l = 0; l < label_count; l++) {
+        if (is_code_label(&labels[l]) && labels[l].offset_ <= instruction_count) {
+            labels[l].offset_ = new_offsets[labels[l].offset_];
+        }
+    }
+    if (entry_point != ENTRY_NOTDEFINED) {
+        entry_point = new_offsets[entry_point];
+    }
+
+    memcpy(instructions, rewritten, count * sizeof(instruction));
+    instruction_count = count;
+}
+
+/**
+ * @brief peephole optimize instructions, between parse and emit, and report what changed
+ */
+void optimize() {
+    optimize_report report = { 0 };
+    sc_uint before = instruction_count;
+
+    // first, so what is inlined is optimized with where it is inlined
+    find_leaders();
+    inline_calls(&report);
+
+    // each rewrite can expose more for the others, e.g. a tail call leaves its RET unreachable
+    for (sc_uint round = 0; round < 8; round++) {
+        sc_bool changed = FALSE;
+
+        find_leaders();
+        changed |= remove_self_moves(&report);
+        changed |= thread_jumps(&report);
+        changed |= make_tail_calls(&report);
+        changed |= remove_unreachable(&report);
+        compact_instructions();
+
+        // needs the removed instructions gone, so next is really next
+        find_leaders();
+        changed |= remove_jumps_to_next(&report);
+        compact_instructions();
+
+        find_leaders();
+        changed |= remove_reloads(&report);
+        compact_instructions();
+
+        if (!changed) {
+            break;
+        }
+    }
+
+    sc_print("optimized %d instructions to %d\n", before, instruction_count);
+    sc_print("  reloads removed           %d\n", report.reloads_);
+    sc_print("  self moves removed        %d\n", report.self_moves_);
+    sc_print("  jumps to jumps threaded   %d\n", report.jumps_to_jumps_);
+    sc_print("  tail calls                %d\n", report.tail_calls_);
+    sc_print("  unreachable removed       %d\n", report.unreachable_);
+    sc_print("  jumps to next removed     %d\n", report.jumps_to_next_);
+    sc_print("  calls inlined             %d\n", report.inlined_);
+}
+
+//-----------------------------------------------------------------------------------------------
+// Block layout, see scasm -P
+//-----------------------------------------------------------------------------------------------
+
+// Basic blocks are joined into chains, each block followed by the one it most often
+// runs next, as counted by scem --profile, so that is a fall through rather than a
+// jump. Chains are then laid out hottest first, so code that never ran ends up last.
+
+typedef struct {
+    sc_uint start_;
+    sc_uint end_;                   // one past last instruction
+    sc_int fall_;                   // block run next when the last instruction does not jump, or -1
+    sc_int target_;                 // block the last instruction jumps to, or -1
+    sc_int next_;                   // in chain, or -1
+    sc_int prev_;
+    sc_int chain_;                  // first block of chain
+    label * label_;                 // at start, NULL until needed
+} block;
+
+typedef struct {
+    sc_uint from_;
+    sc_uint to_;
+    unsigned long long weight_;
+} block_edge;
+
+typedef struct {
+    sc_uint blocks_;
+    sc_uint chains_;
+    sc_uint inverted_;
+    sc_uint jumps_removed_;
+    sc_uint jumps_added_;
+    sc_uint cold_;                  // instructions that never ran
+} layout_report;
+
+// times each instruction ran, summed over tasks
+static unsigned long long profile_counts[MAX_INSRUCTIONS];
+static block blocks[MAX_INSRUCTIONS];
+static sc_uint block_count = 0;
+static sc_uint block_of[MAX_INSRUCTIONS];
+static block_edge block_edges[MAX_INSRUCTIONS * 2];
+static sc_uint layout_order[MAX_INSRUCTIONS];      // first block of each chain
+static sc_uint placed[MAX_INSRUCTIONS];            // blocks, in the order they are laid out
+static unsigned long long heats[MAX_INSRUCTIONS];  // of chain, by its first block
+static sc_int new_label_offsets[MAX_LABELS];
+
+/**
+ * @brief read counts of each pc from rom.prof, written by scem --profile
+ *
+ * @return true if successful and the profile is of this program, otherwise false
+ */
+static sc_bool read_profile(const sc_char * path) {
+    FILE * file = fopen(path, "r");
+    if (file == NULL) {
+        sc_error("ERROR: could not open profile %s\n", path);
+        return FALSE;
+    }
+
+    memset(profile_counts, 0, instruction_count * sizeof(unsigned long long));
+    sc_char text[512];
+    sc_bool ok = TRUE;
+    while (ok && fgets(text, sizeof(text), file)) {
+        // pc task pc count % opcode symbol
+        sc_uint task, pc;
+        unsigned long long count;
+        sc_char op[MAX_OPCODE_SIZE + 1];
+        if (sscanf(text, "pc\t%u\t%u\t%llu\t%*f\t%" stringize_value(MAX_OPCODE_SIZE) "s", &task, &pc, &count, op) != 4) {
+            continue;
+        }
+        if (pc >= instruction_count || !scmp(opcodes[instructions[pc].opcode_].str_, op, MAX_OPCODE_SIZE + 1)) {
+            sc_error("ERROR: profile %s is not of this program, pc %d is not %s\n", path, pc, op);
+            ok = FALSE;
+        }
+        else {
+            profile_counts[pc] += count;
+        }
+    }
+    fclose(file);
+    return ok;
+}
+
+// START runs the first task, and never returns
+static sc_bool falls_through(const instruction * i) {
+    return i->opcode_ != JMP && i->opcode_ != RET && i->opcode_ != HALT && i->opcode_ != START;
+}
+
+static sc_bool ends_block(const instruction * i) {
+    return !falls_through(i) || i->opcode_ == JMPZ || i->opcode_ == JMPNZ;
+}
+
+/**
+ * @brief split instructions into blocks, and find where each goes next
+ *
+ * @return false if the last block runs off the end, so it has to stay last
+ */
+static sc_bool find_blocks() {
+    find_leaders();
+    block_count = 0;
+    for (sc_uint i = 0; i < instruction_count; i++) {
+        if (i == 0 || leaders[i] || ends_block(&instructions[i - 1])) {
+            block b = { i, i, -1, -1, -1, -1, block_count, NULL };
+            blocks[block_count++] = b;
+        }
+        block_of[i] = block_count - 1;
+        blocks[block_count - 1].end_ = i + 1;
+    }
+
+    for (sc_uint b = 0; b < block_count; b++) {
+        const instruction * last = &instructions[blocks[b].end_ - 1];
+        if (is_jump_to_label(last) && last->operands_[0].op_.label_->offset_ < instruction_count) {
+            blocks[b].target_ = block_of[last->operands_[0].op_.label_->offset_];
+        }
+        if (falls_through(last)) {
+            if (b + 1 == block_count) {
+                return FALSE;
+            }
+            blocks[b].fall_ = b + 1;
+        }
+    }
+    return TRUE;
+}
+
+static int compare_edges(const void * a, const void * b) {
+    const block_edge * x = (const block_edge*)a;
+    const block_edge * y = (const block_edge*)b;
+    if (x->weight_ != y->weight_) {
+        return x->weight_ < y->weight_ ? 1 : -1;
+    }
+    // keep to the original order where nothing else decides
+    if (x->from_ != y->from_) {
+        return x->from_ < y->from_ ? -1 : 1;
+    }
+    return x->to_ < y->to_ ? -1 : (x->to_ > y->to_);
+}
+
+/**
+ * @brief times block from is followed by block to, as near as per pc counts tell
+ */
+static unsigned long long edge_weight(sc_uint from, sc_uint to) {
+    unsigned long long last = profile_counts[blocks[from].end_ - 1];
+    unsigned long long first = profile_counts[blocks[to].start_];
+    return last < first ? last : first;
+}
+
+static void make_chains() {
+    sc_uint edge_count = 0;
+    for (sc_uint b = 0; b < block_count; b++) {
+        if (blocks[b].fall_ >= 0) {
+            // blocks that never ran stay as they were
+            block_edge edge = { b, blocks[b].fall_, edge_weight(b, blocks[b].fall_) };
+            if (edge.weight_ > 0 || profile_counts[blocks[edge.to_].start_] == 0) {
+                block_edges[edge_count++] = edge;
+            }
+        }
+        if (blocks[b].target_ >= 0) {
+            block_edge edge = { b, blocks[b].target_, edge_weight(b, blocks[b].target_) };
+            if (edge.weight_ > 0) {
+                block_edges[edge_count++] = edge;
+            }
+        }
+    }
+    qsort(block_edges, edge_count, sizeof(block_edge), compare_edges);
+
+    for (sc_uint e = 0; e < edge_count; e++) {
+        block * from = &blocks[block_edges[e].from_];
+        block * to = &blocks[block_edges[e].to_];
+        if (from->next_ >= 0 || to->prev_ >= 0 || from->chain_ == to->chain_) {
+            continue;
+        }
+        from->next_ = block_edges[e].to_;
+        to->prev_ = block_edges[e].from_;
+        for (sc_int b = block_edges[e].to_; b >= 0; b = blocks[b].next_) {
+            blocks[b].chain_ = from->chain_;
+        }
+    }
+}
+
+static unsigned long long chain_heat(sc_uint head) {
+    // most any instruction in it ran
+    unsigned long long heat = 0;
+    for (sc_int b = head; b >= 0; b = blocks[b].next_) {
+        for (sc_uint i = blocks[b].start_; i < blocks[b].end_; i++) {
+            heat = profile_counts[i] > heat ? profile_counts[i] : heat;
+        }
+    }
+    return heat;
+}
+
+static int compare_chains(const void * a, const void * b) {
+    sc_uint x = *(const sc_uint*)a;
+    sc_uint y = *(const sc_uint*)b;
+    if (heats[x] != heats[y]) {
+        return heats[x] < heats[y] ? 1 : -1;
+    }
+    return x < y ? -1 : (x > y);
+}
+
+/**
+ * @brief label at start of block, made if there is none
+ */
+static label * block_label(sc_uint b) {
+    if (blocks[b].label_ == NULL) {
+        for (sc_uint l = 0; l < label_count; l++) {
+            if (is_code_label(&labels[l]) && labels[l].offset_ == blocks[b].start_) {
+                blocks[b].label_ = &labels[l];
+                return blocks[b].label_;
+            }
+        }
+        // . so it is never the same as a label that is written
+        sc_char name[32];
+        snprintf(name, sizeof(name), ".block%d", blocks[b].start_);
+        blocks[b].label_ = make_label(copy_text(name, slen(name)), blocks[b].start_);
+        if (blocks[b].label_) {
+            blocks[b].label_->segment_ = SEGMENT_TEXT;
+        }
+    }
+    return blocks[b].label_;
+}
+
+static sc_bool push_rewritten(sc_uint * count, instruction i) {
+    if (*count == MAX_INSRUCTIONS) {
+        return FALSE;
+    }
+    rewritten[(*count)++] = i;
+    return TRUE;
+}
+
+/**
+ * @brief lay out chains, inverting or adding jumps so each block still goes where it did
+ *
+ * @return false if it does not fit, then nothing is changed
+ */
+static sc_bool place_blocks(sc_uint chain_count, layout_report * report) {
+    sc_uint order_count = 0;
+    for (sc_uint c = 0; c < chain_count; c++) {
+        for (sc_int b = layout_order[c]; b >= 0; b = blocks[b].next_) {
+            placed[order_count++] = b;
+        }
+    }
+
+    sc_uint count = 0;
+    for (sc_uint o = 0; o < order_count; o++) {
+        block * b = &blocks[placed[o]];
+        sc_int next = o + 1 < order_count ? (sc_int)placed[o + 1] : -1;
+        new_offsets[b->start_] = count;
+        if (profile_counts[b->start_] == 0) {
+            report->cold_ += b->end_ - b->start_;
+        }
+        for (sc_uint i = b->start_; i + 1 < b->end_; i++) {
+            if (!push_rewritten(&count, instructions[i])) {
+                return FALSE;
+            }
+        }
+
+        instruction last = instructions[b->end_ - 1];
+        if (last.opcode_ == JMP && b->target_ >= 0 && b->target_ == next) {
+            report->jumps_removed_++;
+            continue;
+        }
+        if ((last.opcode_ == JMPZ || last.opcode_ == JMPNZ) && b->target_ >= 0 && 
+            b->target_ == next && b->fall_ != next) {
+            last.opcode_ = last.opcode_ == JMPZ ? JMPNZ : JMPZ;
+            last.operands_[0].op_.label_ = block_label(b->fall_);
+            if (last.operands_[0].op_.label_ == NULL) {
+                return FALSE;
+            }
+            report->inverted_++;
+            if (!push_rewritten(&count, last)) {
+                return FALSE;
+            }
+            continue;
+        }
+        if (!push_rewritten(&count, last)) {
+            return FALSE;
+        }
+        if (b->fall_ >= 0 && b->fall_ != next) {
+            operand target = { OP_Label, { .label_ = block_label(b->fall_) } };
+            if (target.op_.label_ == NULL || !push_rewritten(&count, make_instruction(JMP, 1, &target))) {
+                return FALSE;
+            }
+            report->jumps_added_++;
+        }
+    }
+
+    // code labels are encoded in 8 bits, so none below 256 may be moved past it
+    for (sc_uint l = 0; l < label_count; l++) {
+        new_label_offsets[l] = labels[l].offset_;
+        if (is_code_label(&labels[l]) && labels[l].offset_ <= instruction_count) {
+            new_label_offsets[l] = labels[l].offset_ == instruction_count ? count : new_offsets[labels[l].offset_];
+            if (labels[l].offset_ <= 255 && new_label_offsets[l] > 255) {
+                return FALSE;
+            }
+        }
+    }
+    if (entry_point != ENTRY_NOTDEFINED && entry_point <= 255 && new_offsets[entry_point] > 255) {
+        return FALSE;
+    }
+
+    for (sc_uint l = 0; l < label_count; l++) {
+        labels[l].offset_ = new_label_offsets[l];
+    }
+    if (entry_point != ENTRY_NOTDEFINED) {
+        entry_point = new_offsets[entry_point];
+    }
+    memcpy(instructions, rewritten, count * sizeof(instruction));
+    instruction_count = count;
+    return TRUE;
+}
+
+/**
+ * @brief reorder blocks by a profile, between parse, or optimize, and emit
+ *
+ * the profile must be of a ROM assembled from the same source, with the same options,
+ * but without -P, so its pcs are those of the instructions here
+ *
+ * @param profile rom.prof written by scem --profile
+ * @return true if successful, otherwise false.
+ */
+sc_bool layout(const sc_char * profile) {
+    if (!read_profile(profile)) {
+        return FALSE;
+    }
+    if (!find_blocks()) {
+        sc_error("WARNING: last instruction runs off the end, blocks left as they are\n");
+        return TRUE;
+    }
+    make_chains();
+
+    sc_uint chain_count = 0;
+    for (sc_uint b = 0; b < block_count; b++) {
+        if (blocks[b].prev_ < 0) {
+            layout_order[chain_count++] = b;
+            heats[b] = chain_heat(b);
+        }
+    }
+    qsort(layout_order, chain_count, sizeof(sc_uint), compare_chains);
+
+    layout_report report = { block_count, chain_count, 0, 0, 0, 0 };
+    sc_uint before = instruction_count;
+    if (!place_blocks(chain_count, &report)) {
+        sc_error("WARNING: blocks do not fit when laid out, left as they are\n");
+        return TRUE;
+    }
+
+    sc_print("laid out %d instructions as %d\n", before, instruction_count);
+    sc_print("  blocks                    %d\n", report.blocks_);
+    sc_print("  chains                    %d\n", report.chains_);
+    sc_print("  branches inverted         %d\n", report.inverted_);
+    sc_print("  jumps removed             %d\n", report.jumps_removed_);
+    sc_print("  jumps added               %d\n", report.jumps_added_);
+    sc_print("  cold instructions last    %d\n", report.cold_);
+    return TRUE;
+}
+
+//-----------------------------------------------------------------------------------------------
+//-----------------------------------------------------------------------------------------------
+
+typedef struct {
+    sc_uint magic_;
+    sc_uint capabilities_;
+    sc_ushort entry_point_;
+    sc_uint literals_start_;
+    sc_ushort literals_length_;
+    sc_uint code_start_;
+    sc_ushort code_length_;
+} header ;
+
+sc_bool emit(const char* filename) {
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL) {
+        sc_error("ERROR: could not opening file %s\n", filename);
+        return FALSE;
+    }
+
+    // literal_count is in bytes, padded so the code that follows is word aligned
+    align_literals(4);
+    sc_uint lit_bytes = literal_count;
+    sc_uint code_bytes = instruction_count * sizeof(sc_int);
+    header my_header = {
+        .magic_ = 0xDEADBEEF,
+        .capabilities_ = device_capabilities,
+        .entry_point_ = (sc_ushort)entry_point,
+        .literals_start_ = sizeof(header),
+        .literals_length_ = lit_bytes, // in bytes
+        .code_start_ = sizeof(header) + lit_bytes,
+        .code_length_ = code_bytes,
+    };
+
+    sc_print("sc = %d %d\n", literal_count, instruction_count);
+
+    print_instructions();
+
+    size_t bytes_written = fwrite(&my_header, sizeof(header), 1, file);
+    if (bytes_written != 1) {
+        sc_error("Error writing to file\n");
+        fclose(file);
+        return FALSE;
+    }
+
+    bytes_written = fwrite(literals, 1, lit_bytes, file);
+    if (bytes_written != lit_bytes) {
+        sc_error("Error writing data to file\n");
+        fclose(file);
+        return FALSE;
+    }
+
+    // encode and write each instruction
+    for (int i = 0; i < instruction_count; i++) {
+        sc_uint ei = encode_instruction(instructions[i]);
+        bytes_written = fwrite(&ei, 1, 4, file);
+        if (bytes_written != sizeof(sc_uint)) {
+            sc_error("Error writing instruction data to file %zu\n", bytes_written);
+            fclose(file);
+            return FALSE;
+        }
+    }
+
+    // glyph atlases follow the code
+    if (font_atlas_count > 0 && !write_font_atlases(file, font_atlases, font_atlas_count)) {
+        sc_error("Error writing font atlases to file\n");
+        fclose(file);
+        return FALSE;
+    }
+
+    fclose(file);
+
+    return TRUE;
+}
+
+/**
+ * @brief write symbol file for ROM, i.e. filename.sym
+ * 
+ * each line is kind name pc, for @func, @task, and @entry, which is used by
+ * scem --profile to name functions and tasks.
+ *
+ * @param filename of ROM
+ * @return true if successful, otherwise false.
+ */
+sc_bool emit_symbols(const char* filename) {
+    sc_char path[MAX_LABEL_LENGTH*4];
+    snprintf(path, sizeof(path), "%s.sym", filename);
+
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        sc_error("ERROR: could not opening file %s\n", path);
+        return FALSE;
+    }
+
+    fprintf(file, "; symbols for %s\n", filename);
+    for (sc_int i = 0; i < symbol_count; i++) {
+        label * lab = symbols[i].label_;
+        fprintf(file, "%s _%s %d\n", 
+            symbols[i].kind_ == SYM_FUNC ? "func" : "task", lab->name_.str_, lab->offset_);
+    }
+    if (entry_point != ENTRY_NOTDEFINED) {
+        fprintf(file, "entry @entry %d\n", entry_point);
+    }
+
+    fclose(file);
+
+    return TRUE;
+}
+
+//-----------------------------------------------------------------------------------------------
+//-----------------------------------------------------------------------------------------------
+
+sc_bool dis(char* filename) {
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL) {
+        sc_error("Error opening file %s\n", filename);
+        return FALSE;
+    }
+
+    header header_data;
+
+    if (fread(&header_data, sizeof(header), 1, file) != 1) {
+        sc_error("Error reading header from file\n");
+        return FALSE;
+    }
+
+    if (header_data.literals_length_ > MAX_LITERALS) {
+        sc_error("Error literals too large\n");
+        return FALSE;
+    }
+    fseek(file, header_data.literals_start_, SEEK_SET);
+    size_t bytes_read = fread(literals, 1, header_data.literals_length_, file);
+    if (bytes_read != header_data.literals_length_) {
+        sc_error("Error reading literals from file\n");
+        return FALSE;
+    }
+    literal_count = header_data.literals_length_;
+
+    sc_uint* encoded_instructions = (sc_uint*)malloc(header_data.code_length_);
+    fseek(file, header_data.code_start_, SEEK_SET);
+    bytes_read = fread(encoded_instructions, 1, header_data.code_length_, file);
+    if (bytes_read != header_data.code_length_) {
+        sc_error("Error reading code from file\n");
+        return FALSE;
+    }
+
+    instruction_count = header_data.code_length_ / 4;
+    entry_point = header_data.entry_point_;
+
+    //sc_print("sc = %d %d\n", literal_count, instruction_count);
+
+    // display capabilities
+    if (header_data.capabilities_ & USE_DEVICE_CONSOLE) {
+        sc_print("device .Console\n");
+    }
+    if (header_data.capabilities_ & USE_DEVICE_SCREEN) {
+        sc_print("requires device .Screen\n");
+    }
+    if (header_data.capabilities_ & USE_FONT_ATLAS) {
+        sc_uint count;
+        fseek(file, header_data.code_start_ + header_data.code_length_, SEEK_SET);
+        font_atlas * atlases = read_font_atlases(file, &count);
+        if (atlases == NULL) {
+            return FALSE;
+        }
+        for (sc_uint i = 0; i < count; i++) {
+            sc_print("@font \"%s\" #%d\t; %d glyphs, %dx%d atlas\n", atlases[i].path_, atlases[i].point_, 
+                atlases[i].glyph_count_, atlases[i].width_, atlases[i].rows_);
+        }
+        delete_font_atlases(atlases, count);
     }
 
     for(sc_int i = 0; i < instruction_count; i++) {
@@ -15,28 +15,61 @@
 sc_bool read(const char * filename);
 sc_bool parse();
 sc_bool emit(const char* filename);
+sc_bool emit_symbols(const char* filename);
+void set_include_paths(sc_char ** paths, sc_uint count);
+void set_module_cache(const sc_char * dir);
+void optimize();
+sc_bool layout(const sc_char * profile);
 
 int main(int argc, char **argv) {
     sc_char * include_paths[64];
     sc_uint num_include_paths = 0;
     sc_char * input_file = NULL;
     sc_char * output_file = NULL;
+    sc_char * module_cache = NULL;
+    sc_char * profile = NULL;
+    sc_bool symbols = FALSE;
+    sc_bool optimize_code = FALSE;
 
     for (sc_int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "-v") == 0) {
             sc_print("scasm - SC Assembler, 21st Sept 2024.\n");
             return 0;
+        } else if (strcmp(argv[i], "-g") == 0) {
+            // emit symbols, used by scem --profile
+            symbols = TRUE;
+        } else if (strcmp(argv[i], "-O") == 0) {
+            // peephole optimize, and report what changed
+            optimize_code = TRUE;
         } else if (strncmp(argv[i], "-I", 2) == 0) {
             // Check if the filename is directly attached
             if (strlen(argv[i]) > 2) {
+                if (num_include_paths == 64) {
+                    sc_error("ERROR: too many -I options\n");
+                    return 1;
+                }
                 include_paths[num_include_paths] = argv[i] + 2; // Skip "-I" part
                 num_include_paths++;
             } else {
                 sc_error("ERROR: -I option requires a filename\n");
                 return 1;
             }
-               
-            
+        } else if (strncmp(argv[i], "-C", 2) == 0) {
+            // cache parsed @include files in directory, which must exist
+            if (strlen(argv[i]) > 2) {
+                module_cache = argv[i] + 2;
+            } else {
+                sc_error("ERROR: -C option requires a directory\n");
+                return 1;
+            }
+        } else if (strncmp(argv[i], "-P", 2) == 0) {
+            // lay out blocks by rom.prof, from scem --profile of this program without -P
+            if (strlen(argv[i]) > 2) {
+                profile = argv[i] + 2;
+            } else {
+                sc_error("ERROR: -P option requires a profile\n");
+                return 1;
+            }
         } else {
             if (input_file == NULL) {
                 input_file = argv[i];
@@ -57,10 +90,13 @@ int main(int argc, char **argv) {
     //     return 1;
     // }
 	// if(argc != 3) {
-    //     sc_print("usage: scasm [-v, -I<path>] input.sc output.scrom");
+    //     sc_print("usage: scasm [-v, -g, -O, -I<path>, -C<dir>, -P<profile>] input.sc output.scrom");
     //     return 1;
     // }
 
+    set_include_paths(include_paths, num_include_paths);
+    set_module_cache(module_cache);
+
     // read file into buffer for processing
     if (!read(input_file)) {
         return 1;
@@ -71,6 +107,14 @@ int main(int argc, char **argv) {
         return 1;
     }
 
+    if (optimize_code) {
+        optimize();
+    }
+
+    if (profile && !layout(profile)) {
+        return 1;
+    }
+
     // dump what we have created
     //print_instructions();
     // print_constants();
@@ -79,5 +123,9 @@ int main(int argc, char **argv) {
         return 1;
     }
 
+    if (symbols && !emit_symbols(output_file)) {
+        return 1;
+    }
+
     return 0;
 }
\ No newline at end of file
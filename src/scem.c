@@ -12,9 +12,13 @@
 #include <console.h>
 #include <screen.h>
 #include <lfqueue.h>
+#include <profile.h>
+#include <telemetry.h>
 #include <raylib.h>
 #include <time.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <sys/resource.h>
 
 //-----------------------------------------------------------------------------------------------
 // limits
@@ -26,10 +30,14 @@
 // max 8K 32-bit literals
 #define MAX_LITERALS 1024 * 4
 
-#define MAX_MEMORY (MAX_LITERALS + 1024 * 8)
+// 4M bytes, enough for literals, data, and a framebuffer (see .Screen/framebuffer)
+#define MAX_MEMORY (MAX_LITERALS + 1024 * 1024)
 
 #define DEFAULT_STACK_SIZE 1024 * 4
 
+// return stack holds return addresses and any saved register windows
+#define DEFAULT_RETURN_STACK_SIZE 1024 * 4
+
 //-----------------------------------------------------------------------------------------------
 // Types
 //-----------------------------------------------------------------------------------------------
@@ -136,11 +144,16 @@ enum {
 
 // Console device
 #define CONSOLE_WRITE 0
+#define CONSOLE_STR 1
+#define CONSOLE_STRN 2
+#define CONSOLE_INT 3
+#define CONSOLE_FLOAT 4
 
 enum { 
     SCREEN_RESIZE=0, SCREEN_PIXEL, SCREEN_FILL, SCREEN_RECT, 
     SCREEN_BLIT, SCREEN_PALETTE, SCREEN_BEGIN, SCREEN_END, SCREEN_COLOUR,
-    SCREEN_MOVE, SCREEN_FONT, SCREEN_TEXT,
+    SCREEN_MOVE, SCREEN_FONT, SCREEN_TEXT, SCREEN_FRAMEBUFFER, SCREEN_INDEXED, SCREEN_RETAIN,
+    SCREEN_RATE, SCREEN_IMAGE, SCREEN_DRAW, SCREEN_FONTREADY, SCREEN_IMAGEREADY,
 };
 
 //---------------------------------------------------------------------------------------------
@@ -160,9 +173,21 @@ static sc_ushort entry_point = 0;
 
 #define USE_DEVICE_CONSOLE 0x1
 #define USE_DEVICE_SCREEN (0x1 << 1)
+#define USE_FONT_ATLAS (0x1 << 2)
 static sc_uint device_capabilities = 0;
+
+// glyph atlases that follow the code, if ROM uses @font
+static font_atlas * font_atlases = NULL;
+static sc_uint font_atlas_count = 0;
  
 static struct timespec start_time;
+static struct timespec wake_time;
+
+// if true, YIELD does not sleep, used for benchmarking
+static sc_bool no_sleep = FALSE;
+
+// instructions retired, updated when run returns
+static unsigned long long instructions_retired = 0;
 
 static sc_uint running_queue = 0;
 
@@ -173,8 +198,12 @@ static sc_uint running_queue = 0;
 #define GENERATOR_REG_INDEX(r) (r - REG_G0)
 
 static sc_queue * streams[MAX_NUM_STREAMS];
+static sc_uint stream_rates[MAX_NUM_STREAMS];  // SETSF, passed on to generators attached to stream
+static sc_uint stream_flags[MAX_NUM_STREAMS];  // SETSC, see STREAM_LATEST
 
 #define MOUSE_GENERATOR 1
+#define KEYBOARD_GENERATOR 2
+#define CONSOLE_INPUT_GENERATOR 3
 
 // stacks
 
@@ -194,6 +223,8 @@ typedef struct {
     sc_uint rate_;
     sc_uint *stack_;
     sc_int top_;
+    sc_uint *rstack_;
+    sc_int rtop_;
 } task;
 
 static task tasks[16];
@@ -218,6 +249,7 @@ sc_uint allocate_task(sc_uint pc, sc_uint rate) {
     sc_uint id = tasks_count++;
     sc_uint* s = (sc_uint*)malloc(DEFAULT_STACK_SIZE * sizeof(sc_uint));
     sc_uint* r = (sc_uint*)malloc(128 * sizeof(sc_uint));
+    sc_uint* rs = (sc_uint*)malloc(DEFAULT_RETURN_STACK_SIZE * sizeof(sc_uint));
 
     task task = {
         .id_        = id,
@@ -227,8 +259,12 @@ sc_uint allocate_task(sc_uint pc, sc_uint rate) {
         .rate_      = rate,
         .stack_     = s,
         .top_       = -1,
+        .rstack_    = rs,
+        .rtop_      = -1,
     };
     tasks[id] = task;
+    PROFILE_TASK(id, pc);
+    telemetry_task(id, rate);
 
     return id;    
 }
@@ -263,20 +299,29 @@ sc_bool run(sc_uint task_id, sc_bool screen_enabled) {
     sc_uint pc = t.pc_;
     sc_uint* s = t.stack_;
     sc_uint top = t.top_;
+    sc_uint* rs = t.rstack_;
+    sc_uint rtop = t.rtop_;
     sc_uint* registers = t.registers_;
     sc_uint flags = t.flags_;
     sc_uint rate = t.rate_;
 
+    // instructions retired, total and at the start of current period
+    unsigned long long retired = 0;
+    unsigned long long period_retired = 0;
+
     DEBUG("Entering loop\n");
     for(;;) {
         sc_uint i = instructions[pc];
+        retired++;
         sc_uint opcode = (i >> 24) & 0xFF;
+        PROFILE_INSTRUCTION(t.id_, pc, opcode);
 
-        sc_error("(%d: %d) - ", pc, i);
+        DEBUG("(%d: %d) - ", pc, i);
         if (screen_enabled) {
-            // TODO: probably need to close any open files...
+            // window closed, stop the VM so the render thread can shut down
             if (screen_should_close()) {
-                exit(1);
+                instructions_retired = retired;
+                return FALSE;
             }
         }
     //      READ, 
@@ -317,6 +362,22 @@ sc_bool run(sc_uint task_id, sc_bool screen_enabled) {
                 pc = pc + 1;
                 break;
             }
+            case SWRITE: {
+                DEBUG("SWRITE\n");
+                sc_uint sreg = STREAM_REG_INDEX(operand_one(i));
+                sc_queue* s = streams[sreg];
+                sc_uint reg  = operand_two(i);
+                // SWRITE sets cmp flag to 1 if value written, otherwise 0 (stream full)
+                if (enqueue(s, registers[reg])) {
+                    set_cmpbit(&flags);
+                }
+                else {
+                    clear_cmpbit(&flags);
+                }
+
+                pc = pc + 1;
+                break;
+            }
             case JMP: {
                 DEBUG("JMP\n");
                 pc = (i >> 16) & 0xFF;
@@ -375,23 +436,38 @@ sc_bool run(sc_uint task_id, sc_bool screen_enabled) {
             }
             case CALL: {
                 DEBUG("CALL\n");
-                dump_stack(s, top);
-                sc_uint pc_target = (i >> 16) & 0xFF;
+                sc_uint pc_target = operand_one(i);
+                // callee's register window, if any
+                sc_uint window_base = operand_two(i);
+                sc_uint window_count = operand_three(i);
+                for (sc_uint w = 0; w < window_count; w++) {
+                    stack_push(rs, &rtop, registers[window_base + w]);
+                }
+                stack_push(rs, &rtop, (window_base << 8) | window_count);
                 // push return address
-                stack_push(s, &top, pc+1);
+                stack_push(rs, &rtop, pc+1);
+                PROFILE_CALL(t.id_, pc_target);
                 pc = pc_target;
                 break;
             }
             case RET: {
-                //TODO: seperate return stack
-                dump_stack(s, top);
-                pc = stack_pop(s, &top);
+                pc = stack_pop(rs, &rtop);
+                // restore caller's registers in the window, if any
+                sc_uint window = stack_pop(rs, &rtop);
+                sc_uint window_base = (window >> 8) & 0xFF;
+                sc_uint window_count = window & 0xFF;
+                while (window_count > 0) {
+                    window_count--;
+                    registers[window_base + window_count] = stack_pop(rs, &rtop);
+                }
+                PROFILE_RET(t.id_);
                 DEBUG("RET (%d)\n", pc);
 
                 break;
             }
             case HALT: {
                 DEBUG("HALT\n");
+                instructions_retired = retired;
                 return TRUE;
             }
             case ADD: {
@@ -434,8 +510,8 @@ sc_bool run(sc_uint task_id, sc_bool screen_enabled) {
                 sc_uint reg_dst = operand_one(i);
                 sc_uint reg_op1 = operand_two(i);
                 sc_uint reg_op2 = operand_three(i);
-                sc_float op1 = (sc_float)*((sc_int*)&registers[reg_op1]);
-                sc_float op2 = (sc_float)*((sc_int*)&registers[reg_op2]);
+                sc_float op1 = *((sc_float*)&registers[reg_op1]);
+                sc_float op2 = *((sc_float*)&registers[reg_op2]);
                 sc_float result = op1 + op2;
                 registers[reg_dst] = *((sc_uint*)&result);
                 pc = pc + 1;
@@ -446,8 +522,8 @@ sc_bool run(sc_uint task_id, sc_bool screen_enabled) {
                 sc_uint reg_dst = operand_one(i);
                 sc_uint reg_op1 = operand_two(i);
                 sc_uint reg_op2 = operand_three(i);
-                sc_float op1 = (sc_float)*((sc_int*)&registers[reg_op1]);
-                sc_float op2 = (sc_float)*((sc_int*)&registers[reg_op2]);
+                sc_float op1 = *((sc_float*)&registers[reg_op1]);
+                sc_float op2 = *((sc_float*)&registers[reg_op2]);
                 sc_float result = op1 - op2;
                 registers[reg_dst] = *((sc_uint*)&result);
                 pc = pc + 1;
@@ -458,8 +534,8 @@ sc_bool run(sc_uint task_id, sc_bool screen_enabled) {
                 sc_uint reg_dst = operand_one(i);
                 sc_uint reg_op1 = operand_two(i);
                 sc_uint reg_op2 = operand_three(i);
-                sc_float op1 = (sc_float)*((sc_int*)&registers[reg_op1]);
-                sc_float op2 = (sc_float)*((sc_int*)&registers[reg_op2]);
+                sc_float op1 = *((sc_float*)&registers[reg_op1]);
+                sc_float op2 = *((sc_float*)&registers[reg_op2]);
                 sc_float result = op1 * op2;
                 registers[reg_dst] = *((sc_uint*)&result);
                 pc = pc + 1;
@@ -559,6 +635,22 @@ sc_bool run(sc_uint task_id, sc_bool screen_enabled) {
                 pc = pc + 1;
                 break;
             }
+            case LDRB: {
+                DEBUG("LDRB\n");
+                sc_uint reg_dst = operand_one(i);
+                sc_uint reg_addr = operand_two(i);
+                registers[reg_dst] = memory_pool_char[registers[reg_addr]];
+                pc = pc + 1;
+                break;
+            }
+            case STRB: {
+                DEBUG("STRB\n");
+                sc_uint reg_addr = operand_one(i);
+                sc_uint reg_src = operand_two(i);
+                memory_pool_char[registers[reg_addr]] = (sc_uchar)registers[reg_src];
+                pc = pc + 1;
+                break;
+            }
             // other load and stores
             //SPAWN, YIELD, START,
             case SPAWN: {
@@ -571,23 +663,54 @@ sc_bool run(sc_uint task_id, sc_bool screen_enabled) {
                 pc = pc + 1;
                 break;
             }
+            case AWAIT:
+                // wait for fonts and images being loaded, the task still yields each
+                // period, so the wait never stalls it for longer than a YIELD would
+                if (!screen_enabled || !screen_loading()) {
+                    pc = pc + 1;
+                    break;
+                }
+                // fall through
             case YIELD: {
                 DEBUG("YIELD\n");
                 //pc = tasks[running_queue].pc_;
                 struct timespec end_time;
                 clock_gettime(CLOCK_MONOTONIC, &end_time);
-                // Calculate the elapsed time in nanoseconds
-                long long elapsed_time_ns = (end_time.tv_sec - start_time.tv_sec) * 1000000000LL + end_time.tv_nsec - start_time.tv_nsec;
+                // time spent running since task last woke up
+                long long cpu_time_ns = (end_time.tv_sec - wake_time.tv_sec) * 1000000000LL + end_time.tv_nsec - wake_time.tv_nsec;
 
-                pc = pc + 1;
-                long long time_left = (1000000000 / rate) - elapsed_time_ns;
-                if (time_left > 0) {
+                if (opcode == YIELD) {
+                    pc = pc + 1;
+                }
+                // start_time is the deadline of the previous period, next deadline is 
+                // one period later, rate of 0 means as fast as possible
+                long long period_ns = rate > 0 ? 1000000000LL / rate : 0;
+                long long time_left = period_ns - ((end_time.tv_sec - start_time.tv_sec) * 1000000000LL + end_time.tv_nsec - start_time.tv_nsec);
+                telemetry_period(t.id_, cpu_time_ns, retired - period_retired, rate > 0 && time_left < 0);
+                if (time_left > 0 && !no_sleep) {
                     struct timespec sleep_time;
-                    sleep_time.tv_sec = 0;
-                    sleep_time.tv_nsec = time_left;
+                    sleep_time.tv_sec = time_left / 1000000000LL;
+                    sleep_time.tv_nsec = time_left % 1000000000LL;
                     nanosleep(&sleep_time, NULL);
+
+                    // advance deadline, rather than using the wake up time, so we don't drift
+                    start_time.tv_nsec += period_ns % 1000000000LL;
+                    start_time.tv_sec += period_ns / 1000000000LL + start_time.tv_nsec / 1000000000LL;
+                    start_time.tv_nsec = start_time.tv_nsec % 1000000000LL;
                 } 
-                start_time = end_time;
+                else {
+                    // fallen behind, so resync rather than trying to catch up
+                    start_time = end_time;
+                }
+
+                clock_gettime(CLOCK_MONOTONIC, &wake_time);
+                if (time_left > 0 && !no_sleep) {
+                    // how late did we wake up
+                    long long jitter_ns = (wake_time.tv_sec - start_time.tv_sec) * 1000000000LL + wake_time.tv_nsec - start_time.tv_nsec;
+                    telemetry_wakeup(t.id_, jitter_ns);
+                }
+                telemetry_publish(wake_time.tv_sec * 1000000000ULL + wake_time.tv_nsec);
+                period_retired = retired;
                 break;
             }
             case START: {
@@ -598,6 +721,8 @@ sc_bool run(sc_uint task_id, sc_bool screen_enabled) {
                 pc = t.pc_;
                 s = t.stack_;
                 top = t.top_;
+                rs = t.rstack_;
+                rtop = t.rtop_;
                 registers = t.registers_;
                 flags = t.flags_;
                 rate = t.rate_;
@@ -608,10 +733,35 @@ sc_bool run(sc_uint task_id, sc_bool screen_enabled) {
                 sc_uint console_command = operand_one(i);
                 sc_uint reg = operand_two(i);
 
+                PROFILE_DEVICE_BEGIN();
                 if (console_command == CONSOLE_WRITE) {
                     // write command
                     write_console(registers[reg]);
                 }
+                else if (console_command == CONSOLE_STR || console_command == CONSOLE_STRN) {
+                    // string from memory, up to NUL or given length, never past the end of memory
+                    sc_uint addr = registers[reg];
+                    sc_uint limit = addr < MAX_MEMORY * sizeof(sc_uint) ? MAX_MEMORY * sizeof(sc_uint) - addr : 0;
+                    const sc_char * str = (const sc_char*)&memory_pool_char[addr];
+                    sc_uint length = 0;
+                    if (console_command == CONSOLE_STRN) {
+                        length = registers[operand_three(i)];
+                        length = length < limit ? length : limit;
+                    }
+                    else {
+                        while (length < limit && str[length] != '\0') {
+                            length++;
+                        }
+                    }
+                    write_console_string(str, length);
+                }
+                else if (console_command == CONSOLE_INT) {
+                    write_console_int((sc_int)registers[reg]);
+                }
+                else if (console_command == CONSOLE_FLOAT) {
+                    write_console_float(*((sc_float*)&registers[reg]));
+                }
+                PROFILE_DEVICE_END(PROFILE_DEVICE_CONSOLE, console_command);
                 pc = pc + 1;
                 break;
             }
@@ -619,6 +769,7 @@ sc_bool run(sc_uint task_id, sc_bool screen_enabled) {
                 DEBUG("SCREEN\n");
                 sc_uint screen_command = operand_one(i);
 
+                PROFILE_DEVICE_BEGIN();
                 switch (screen_command) {
                     case SCREEN_RESIZE: {
                         // create/resize window command
@@ -651,7 +802,6 @@ sc_bool run(sc_uint task_id, sc_bool screen_enabled) {
                         break;
                     }
                     case SCREEN_BEGIN: {
-                        screen_process_events();
                         screen_begin_frame();
                         // screen_colour(0);
                         // screen_fill();
@@ -692,11 +842,105 @@ sc_bool run(sc_uint task_id, sc_bool screen_enabled) {
                         screen_text(index, str);
                         break;
                     }
+                    case SCREEN_FRAMEBUFFER: {
+                        // 32-bit ARGB pixels in VM memory, size is packed as width << 16 | height
+                        sc_uint reg_addr = operand_two(i);
+                        sc_uint reg_size = operand_three(i);
+                        sc_uint addr = registers[reg_addr];
+                        sc_uint w = registers[reg_size] >> 16;
+                        sc_uint h = registers[reg_size] & 0xFFFF;
+                        if ((addr & 3) != 0 || 
+                            (unsigned long long)addr + (unsigned long long)w * h * 4 > sizeof(memory_pool)) {
+                            sc_error("ERROR: framebuffer %u (%ux%u) outside of memory\n", addr, w, h);
+                            break;
+                        }
+                        screen_framebuffer((sc_uint*)&memory_pool_char[addr], w, h);
+                        break;
+                    }
+                    case SCREEN_INDEXED: {
+                        // 8-bit palette indices in VM memory, size is packed as width << 16 | height
+                        sc_uint reg_addr = operand_two(i);
+                        sc_uint reg_size = operand_three(i);
+                        sc_uint addr = registers[reg_addr];
+                        sc_uint w = registers[reg_size] >> 16;
+                        sc_uint h = registers[reg_size] & 0xFFFF;
+                        if ((unsigned long long)addr + (unsigned long long)w * h > sizeof(memory_pool)) {
+                            sc_error("ERROR: framebuffer %u (%ux%u) outside of memory\n", addr, w, h);
+                            break;
+                        }
+                        screen_framebuffer_indexed(&memory_pool_char[addr], w, h);
+                        break;
+                    }
+                    case SCREEN_RETAIN: {
+                        sc_uint reg_flag = operand_two(i);
+                        screen_retain(registers[reg_flag] != 0);
+                        break;
+                    }
+                    case SCREEN_RATE: {
+                        // frames are not paced when sleeping is disabled
+                        sc_uint reg_fps = operand_two(i);
+                        if (!no_sleep) {
+                            screen_set_rate(registers[reg_fps]);
+                        }
+                        break;
+                    }
+                    case SCREEN_PALETTE: {
+                        // count 32-bit ARGB entries, replacing palette from index 0
+                        sc_uint reg_addr = operand_two(i);
+                        sc_uint reg_count = operand_three(i);
+                        sc_uint addr = registers[reg_addr];
+                        sc_uint count = registers[reg_count];
+                        if ((addr & 3) != 0 || 
+                            (unsigned long long)addr + (unsigned long long)count * 4 > sizeof(memory_pool)) {
+                            sc_error("ERROR: palette %u (%u entries) outside of memory\n", addr, count);
+                            break;
+                        }
+                        screen_palette((sc_uint*)&memory_pool_char[addr], count);
+                        break;
+                    }
+                    case SCREEN_BLIT: {
+                        // upload and draw framebuffer rectangle, packed as x << 16 | y and w << 16 | h
+                        sc_uint reg_xy = operand_two(i);
+                        sc_uint reg_wh = operand_three(i);
+                        sc_uint xy = registers[reg_xy];
+                        sc_uint wh = registers[reg_wh];
+                        screen_blit(xy >> 16, xy & 0xFFFF, wh >> 16, wh & 0xFFFF);
+                        break;
+                    }
+                    case SCREEN_IMAGE: {
+                        sc_uint reg_index = operand_two(i);
+                        sc_uint reg_filename = operand_three(i);
+                        sc_char* filename = (sc_char*)(&memory_pool_char[registers[reg_filename]]);
+                        screen_image(registers[reg_index], filename);
+                        break;
+                    }
+                    case SCREEN_DRAW: {
+                        sc_uint reg_index = operand_two(i);
+                        screen_draw_image(registers[reg_index]);
+                        break;
+                    }
+                    case SCREEN_FONTREADY:
+                    case SCREEN_IMAGEREADY: {
+                        // status of slot, cmp flag is set if it is loaded
+                        sc_uint reg_status = operand_two(i);
+                        sc_uint reg_index = operand_three(i);
+                        sc_uint status = screen_command == SCREEN_FONTREADY ? 
+                            screen_font_status(registers[reg_index]) : screen_image_status(registers[reg_index]);
+                        registers[reg_status] = status;
+                        if (status == ASSET_READY) {
+                            set_cmpbit(&flags);
+                        }
+                        else {
+                            clear_cmpbit(&flags);
+                        }
+                        break;
+                    }
                     default: {
                         sc_error("ERROR: unknown screen command %d\n", screen_command);
                         break;
                     }
                 }
+                PROFILE_DEVICE_END(PROFILE_DEVICE_SCREEN, screen_command);
                 pc = pc + 1;
                 break;
             }
@@ -730,11 +974,17 @@ sc_bool run(sc_uint task_id, sc_bool screen_enabled) {
             }
             case SETSF: {
                 DEBUG("SETSF\n");
+                sc_uint sreg = STREAM_REG_INDEX(operand_one(i));
+                sc_uint reg = operand_two(i);
+                // SR is not backed by a register, it is the default sample rate
+                stream_rates[sreg] = reg == REG_SR ? DEFAULT_SAMPLE_RATE : registers[reg];
                 pc = pc + 1;
                 break;
             }
             case SETSC: {
                 DEBUG("SETSC\n");
+                sc_uint sreg = STREAM_REG_INDEX(operand_one(i));
+                stream_flags[sreg] = operand_two(i);
                 pc = pc + 1;
                 break;
             }
@@ -746,7 +996,14 @@ sc_bool run(sc_uint task_id, sc_bool screen_enabled) {
 
                 if (greg == MOUSE_GENERATOR) {
                     // connect mouse generator to stream
-                    attach_mouse_generator(streams[sreg]);
+                    attach_mouse_generator(streams[sreg], stream_rates[sreg], stream_flags[sreg]);
+                }
+                else if (greg == KEYBOARD_GENERATOR) {
+                    attach_keyboard_generator(streams[sreg], stream_rates[sreg], stream_flags[sreg]);
+                }
+                else if (greg == CONSOLE_INPUT_GENERATOR) {
+                    // register selects bytes or lines
+                    attach_console_input_generator(streams[sreg], registers[reg]);
                 }
                 pc = pc + 1;
                 break;
@@ -763,6 +1020,13 @@ sc_bool run(sc_uint task_id, sc_bool screen_enabled) {
     return TRUE;
 }
 
+// VM thread entry when the screen is enabled, the main thread renders
+static void * vm_thread(void * main_id) {
+    run(*(sc_uint*)main_id, TRUE);
+    screen_stop();
+    return NULL;
+}
+
 //---------------------------------------------------------------------------------------------
 //---------------------------------------------------------------------------------------------
 
@@ -800,20 +1064,83 @@ sc_bool load(char * filename) {
     entry_point = header_data.entry_point_;
     device_capabilities = header_data.capabilities_;
 
+    if (device_capabilities & USE_FONT_ATLAS) {
+        fseek(file, header_data.code_start_ + header_data.code_length_, SEEK_SET);
+        font_atlases = read_font_atlases(file, &font_atlas_count);
+        if (font_atlases == NULL) {
+            return FALSE;
+        }
+    }
+
     return TRUE;
 }
 
 sc_int main(int argc, char** argv) {
-    if(argc == 2 && scmp(argv[1], "-v", 2)) {
-        sc_print("scem - SC Emulator, 30th Sept 2024.\n");
+    sc_char * input_file = NULL;
+    sc_bool profile = FALSE;
+    sc_bool profile_devices = FALSE;
+    sc_char * telemetry_target = NULL;
+    sc_uint telemetry_interval_ms = 1000;
+    sc_bool bench = FALSE;
+    sc_bool headless = FALSE;
+    sc_char * frame_dir = NULL;
+    sc_bool retain = FALSE;
+
+    for (sc_int i = 1; i < argc; i++) {
+        if (scmp(argv[i], "-v", 3)) {
+            sc_print("scem - SC Emulator, 30th Sept 2024.\n");
+            return 1;
+        } else if (scmp(argv[i], "--profile", 10)) {
+            profile = TRUE;
+        } else if (scmp(argv[i], "--profile-devices", 18)) {
+            // also time each device call
+            profile = TRUE;
+            profile_devices = TRUE;
+        } else if (scmp(argv[i], "--telemetry", 12) && i + 1 < argc) {
+            // file path or unix:path
+            telemetry_target = argv[++i];
+        } else if (scmp(argv[i], "--telemetry-interval", 21) && i + 1 < argc) {
+            telemetry_interval_ms = atoi(argv[++i]);
+        } else if (scmp(argv[i], "--nosleep", 10)) {
+            no_sleep = TRUE;
+        } else if (scmp(argv[i], "--bench", 8)) {
+            // report instructions/sec, ns/op, and memory use at exit
+            bench = TRUE;
+        } else if (scmp(argv[i], "--headless", 11)) {
+            // screen renders into an offscreen framebuffer, no display needed
+            headless = TRUE;
+        } else if (scmp(argv[i], "--dump-frames", 14) && i + 1 < argc) {
+            // write each frame as a BMP to dir, implies --headless
+            headless = TRUE;
+            frame_dir = argv[++i];
+        } else if (scmp(argv[i], "--retain", 9)) {
+            // start screen in retained mode, as .Screen/retain
+            retain = TRUE;
+        } else if (input_file == NULL) {
+            input_file = argv[i];
+        }
+    }
+
+	if(input_file == NULL) {
+        sc_print("usage: scem [-v, --profile, --profile-devices, --telemetry file|unix:path, --telemetry-interval ms, --nosleep, --bench, --headless, --dump-frames dir, --retain] input.scrom");
         return 1;
     }
-	if(argc != 2) {
-        sc_print("usage: scem [-v] input.scrom");
+
+    if (profile) {
+        if (!has_profiler()) {
+            sc_error("ERROR: scem built without profiling support (make PROFILE=1)\n");
+            return 1;
+        }
+        if (!enable_profiler(input_file, profile_devices)) {
+            return 1;
+        }
+    }
+
+    if (telemetry_target && !enable_telemetry(telemetry_target, telemetry_interval_ms)) {
         return 1;
     }
 
-    if(load(argv[1])) {
+    if(load(input_file)) {
         // binary loaded
 
         // check capabilities and initialize any required devices
@@ -833,8 +1160,13 @@ sc_int main(int argc, char** argv) {
                 sc_error("ERROR: required screen device not supported\n");
             }
             DEBUG("Initializing screen\n");
-            init_screen();
-            screen_set_rate(30); // default screen rate
+            if (!(headless ? init_headless_screen(frame_dir) : init_screen())) {
+                sc_error("ERROR: screen would not initialize%s\n", headless ? "" : ", try --headless");
+                return 1;
+            }
+            screen_set_rate(no_sleep ? 0 : 30); // default screen rate
+            screen_font_atlases(font_atlases, font_atlas_count);
+            screen_retain(retain);
             screen_enabled = TRUE;
         }
 
@@ -846,11 +1178,81 @@ sc_int main(int argc, char** argv) {
 
         // initialize clock
         clock_gettime(CLOCK_MONOTONIC, &start_time);
-        run(main_id, screen_enabled);
+        wake_time = start_time;
+        struct timespec vm_start = start_time;
+        if (screen_enabled) {
+            // SDL wants events and rendering on the main thread, so the VM gets its own
+            pthread_t vm;
+            if (pthread_create(&vm, NULL, vm_thread, &main_id) != 0) {
+                sc_error("ERROR: could not create VM thread\n");
+                return 1;
+            }
+            screen_run();
+            pthread_join(vm, NULL);
+        }
+        else {
+            run(main_id, screen_enabled);
+        }
+
+        if (device_capabilities & USE_DEVICE_CONSOLE) {
+            // write out anything buffered, before any bench output
+            delete_console();
+        }
+
+        if (bench) {
+            struct timespec vm_end;
+            clock_gettime(CLOCK_MONOTONIC, &vm_end);
+            double seconds = (vm_end.tv_sec - vm_start.tv_sec) + (vm_end.tv_nsec - vm_start.tv_nsec) / 1e9;
+
+            struct rusage usage;
+            getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+            long max_rss_kb = usage.ru_maxrss / 1024; // bytes on MacOS
+#else
+            long max_rss_kb = usage.ru_maxrss;
+#endif
+            // one JSON object per line
+            sc_print("{\"rom\":\"%s\",\"instructions\":%llu,\"seconds\":%.6f,"
+                     "\"instructions_per_sec\":%.0f,\"ns_per_op\":%.3f,\"max_rss_kb\":%ld",
+                input_file, instructions_retired, seconds, 
+                seconds > 0 ? instructions_retired / seconds : 0.0,
+                instructions_retired > 0 ? seconds * 1e9 / instructions_retired : 0.0,
+                max_rss_kb);
+
+            screen_stats frames;
+            if (screen_enabled && screen_frame_stats(&frames)) {
+                sc_print(",\"frames\":%llu,\"frame_ns_avg\":%llu,\"frame_ns_min\":%llu,"
+                         "\"frame_ns_max\":%llu,\"draw_commands\":%u,\"draw_calls\":%u,\"damage_pixels\":%u,\"frames_skipped\":%llu,"
+                         "\"frames_published\":%llu,\"frames_dropped\":%llu,\"frames_late\":%llu,"
+                         "\"frame_period_ns\":%llu,\"interval_ns_avg\":%llu,\"interval_ns_max\":%llu,\"vsync\":%s,"
+                         "\"text_hits\":%llu,\"text_misses\":%llu,\"fonts_baked\":%llu,\"fonts_rasterized\":%llu,"
+                         "\"font_load_ns\":%llu,\"images_loaded\":%llu,\"events_coalesced\":%llu,\"events_dropped\":%llu,"
+                         "\"framebuffer_hash\":\"%08x\"",
+                    frames.frames_, frames.frame_ns_total_ / frames.frames_, 
+                    frames.frame_ns_min_, frames.frame_ns_max_, 
+                    frames.draw_commands_last_, frames.draw_calls_last_, 
+                    frames.damage_pixels_last_, frames.frames_skipped_, 
+                    frames.frames_published_, frames.frames_dropped_, frames.frames_late_,
+                    frames.frame_period_ns_, 
+                    frames.frames_ > 1 ? frames.interval_ns_total_ / (frames.frames_ - 1) : 0,
+                    frames.interval_ns_max_, frames.vsync_ ? "true" : "false",
+                    frames.text_hits_, frames.text_misses_,
+                    frames.fonts_baked_, frames.fonts_rasterized_, frames.font_load_ns_, frames.images_loaded_,
+                    frames.events_coalesced_, frames.events_dropped_,
+                    frames.framebuffer_hash_);
+            }
+            if (device_capabilities & USE_DEVICE_CONSOLE) {
+                unsigned long long console_bytes, console_dropped;
+                console_stats(&console_bytes, &console_dropped);
+                sc_print(",\"console_bytes\":%llu,\"console_dropped\":%llu", console_bytes, console_dropped);
+            }
+            sc_print("}\n");
+        }
 
         if (screen_enabled) {
             delete_screen();
         }
+        delete_font_atlases(font_atlases, font_atlas_count);
     }
 
     return 0;
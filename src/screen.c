@@ -14,64 +14,201 @@
 #include "SDL_FontCache.h"
 
 #include <screen.h>
+#include <draw_list.h>
+#include <palette.h>
+#include <text_cache.h>
+#include <asset_loader.h>
+
+#include <time.h>
+#include <string.h>
+#include <stdatomic.h>
 
 //#if defined(__DESKTOP__)
 
 //-------------------------------------------------------------------------------------
+// state shared between the VM and render threads
+//-------------------------------------------------------------------------------------
+
+// ARGB, see .Screen/palette
+#define DEFAULT_PALETTE { \
+    0xFF000000,     /* black */ \
+    0xFFFFFFFF,     /* white */ \
+    0xFFFF0000,     /* red */ \
+    0xFF00FF00,     /* green */ \
+    0xFF0000FF,     /* blue */ \
+    0 }
 
 typedef struct {
-    unsigned char red_;
-    unsigned char green_;
-    unsigned char blue_;
-} colour;
+    draw_list * commands_;
+    sc_uint palette_[PALETTE_SIZE];
+    sc_bool retained_;
+    sc_bool redraw_;
+} screen_frame;
 
-static colour colour_pallet[16] = { 
-    { 0, 0, 0},        // black
-    { 255, 255, 255 }, // white
-    { 255, 0, 0, },     // red
-    { 0, 255, 0 },      // green
-    { 0, 0, 255},       // blue 
+// triple buffered frames, the VM records into one, one is waiting to be rendered
+// and one is being rendered, frames are handed over by swapping indices, so 
+// neither thread waits for the other
+#define NUM_FRAMES 3
+#define FRAME_FRESH 0x4     // set on ready_frame when a frame is published
 
-    0 
-};
+static screen_frame frames[NUM_FRAMES];
+static atomic_uint ready_frame = 1;
 
-//-------------------------------------------------------------------------------------
+// requests that must not be dropped, VM thread to render thread
+enum { REQUEST_RESIZE=0 };
+
+#define MAX_REQUESTS 64
 
+typedef struct {
+    sc_uint kind_;
+    sc_ushort width_;
+    sc_ushort height_;
+    sc_int scale_;
+} screen_request;
+
+static screen_request requests[MAX_REQUESTS];
+static atomic_uint requests_head = 0;   // next to be handled, render thread
+static atomic_uint requests_tail = 0;   // next free, VM thread
+
+// font and image slots, loaded by the asset loader, see screen_font_status
 #define MAX_FONTS 9
+#define MAX_IMAGES 16
 
-static FC_Font* fonts[MAX_FONTS] = { 0 };
+static atomic_uint font_pending[MAX_FONTS];     // loads requested but not yet uploaded
+static atomic_uint font_state[MAX_FONTS];       // of the last upload, ASSET_READY or ASSET_FAILED
+static atomic_uint image_pending[MAX_IMAGES];
+static atomic_uint image_state[MAX_IMAGES];
+
+// glyph atlases baked into the ROM, set before either thread starts, see screen_font_atlases
+static const font_atlas * atlases = NULL;
+static SDL_Surface ** atlas_surfaces = NULL;
+static sc_uint atlas_count = 0;
+
+static atomic_int quit = FALSE;
+static atomic_int stop = FALSE;
+static atomic_ullong frame_period_ns = 0;   // see screen_set_rate
+static sc_generator mouse;    // attached by the VM thread, fed by the render thread
+static sc_generator keyboard;
 
-static sc_int number_fonts = 0;
+//-------------------------------------------------------------------------------------
+// VM thread
+//-------------------------------------------------------------------------------------
+
+static sc_uint recording_frame = 0;
+static sc_short screen_x = 0;
+static sc_short screen_y = 0;
+static sc_uchar colour_index = 0;
+static sc_uint vm_palette[PALETTE_SIZE] = DEFAULT_PALETTE;
+static sc_bool vm_retained = FALSE;
+static sc_bool vm_redraw = TRUE;
+static unsigned long long frames_published = 0;
 
+// framebuffer in VM memory, see screen_blit
+static sc_uint * fb_pixels = NULL;
+static sc_uchar * fb_indices = NULL;    // indexed mode, otherwise NULL
+static sc_ushort fb_width = 0;
+static sc_ushort fb_height = 0;
+
+// frames are rendered one at a time, so every one can be dumped
+static sc_bool lockstep = FALSE;
+
+//-------------------------------------------------------------------------------------
+// render thread
 //-------------------------------------------------------------------------------------
 
+static FC_Font* fonts[MAX_FONTS] = { 0 };
+static sc_int font_rom_atlas[MAX_FONTS];    // atlas font was loaded from, so it can be reloaded, or -1
+
+// surfaces are kept, so textures can be made again if the renderer is
+static SDL_Surface* image_surfaces[MAX_IMAGES] = { 0 };
+static SDL_Texture* image_textures[MAX_IMAGES] = { 0 };
+
+// laid out text, so labels drawn every frame are not laid out every frame
+#define TEXT_CACHE_SIZE 256
+
+static text_cache * text_runs = NULL;
+
 static sc_int window_width = 400;
 static sc_int window_height = 400;
+static sc_int screen_scale = 1;
 static SDL_Window* window = NULL;
 static SDL_Renderer* renderer = NULL;
-static sc_short screen_x = 0;
-static sc_short screen_y = 0;
-static sc_uchar colour_index = 0;
-static sc_bool quit = FALSE;
-static sc_queue *mouse_queue = NULL;
-static sc_int mouse_x = 0;
-static sc_int mouse_y = 0;
+static sc_bool vsync = FALSE;
+
+// frame pacing
+static unsigned long long next_frame_ns = 0;
+static unsigned long long last_frame_ns = 0;
+
+static sc_uint presenting_frame = 2;
+static sc_uint palette[PALETTE_SIZE] = DEFAULT_PALETTE;
+
+// headless backend, renders into framebuffer rather than a window
+static sc_bool headless = FALSE;
+static SDL_Surface* framebuffer = NULL;
+static const sc_char * frame_dump_dir = NULL;
+
+// max points or rects per SDL call
+#define MAX_BATCH 4096
+
+static SDL_Point batch_points[MAX_BATCH];
+static sc_int batch_points_count = 0;
+static SDL_Rect batch_rects[MAX_BATCH];
+static sc_int batch_rects_count = 0;
+static sc_uint draw_calls = 0;
+
+// screen sized, blitted rectangles are uploaded into it
+static SDL_Texture * fb_texture = NULL;
+
+// retained mode, only the area that changed since the last frame is redrawn and 
+// unchanged frames are not presented at all
+static sc_bool retained = FALSE;
+static sc_bool full_damage = TRUE;
+static draw_list * last_commands = NULL;    // presented last frame
+static SDL_Texture * canvas = NULL;         // window only, headless framebuffer persists anyway
+
+static screen_stats stats = { 0 };
+
+//-------------------------------------------------------------------------------------
+
+static unsigned long long now_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static void sleep_us(sc_uint us) {
+    struct timespec t = { 0, us * 1000 };
+    nanosleep(&t, NULL);
+}
 
 sc_bool has_screen_device() {
     return TRUE;
 }
 
 void screen_set_rate(sc_int fps) {
+    atomic_store(&frame_period_ns, fps > 0 ? 1000000000ULL / fps : 0);
 }
 
 sc_bool screen_should_close() {
-    return quit;
+    return atomic_load_explicit(&quit, memory_order_relaxed);
+}
+
+static void init_frames() {
+    for (sc_int i = 0; i < NUM_FRAMES; i++) {
+        frames[i].commands_ = allocate_draw_list();
+    }
+    last_commands = allocate_draw_list();
+    text_runs = allocate_text_cache(TEXT_CACHE_SIZE);
+    for (sc_int i = 0; i < MAX_FONTS; i++) {
+        font_rom_atlas[i] = -1;
+    }
 }
 
 sc_bool init_screen() {
-    // returns zero on success else non-zero
+    // returns true on success else false
     if (SDL_Init(SDL_INIT_EVERYTHING) != 0) {
         sc_error("ERROR: initializing SDL: %s\n", SDL_GetError());
+        return FALSE;
     }
 
     window = SDL_CreateWindow("sample control",
@@ -81,48 +218,197 @@ sc_bool init_screen() {
 
     if (window == NULL) {
         sc_error("ERROR: SDL window failed to initialise: %s\n", SDL_GetError());
-        return 1;
+        return FALSE;
     }
 
-    renderer =  SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+    // vsync if it is available, present then never runs ahead of the display
+    renderer =  SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+    if (renderer == NULL) {
+        renderer =  SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+    }
     
     if (renderer == NULL) {
         sc_error("ERROR: SDL window failed to initialise: %s\n", SDL_GetError());
-        return 1;
+        return FALSE;
+    }
+
+    SDL_RendererInfo info;
+    if (SDL_GetRendererInfo(renderer, &info) == 0) {
+        vsync = (info.flags & SDL_RENDERER_PRESENTVSYNC) != 0;
     }
     //SDL_SetHintWithPriority(SDL_HINT_MOUSE_RELATIVE_MODE_WARP, "1", SDL_HINT_OVERRIDE);
     SDL_SetRelativeMouseMode(SDL_FALSE);
     // SDL_SetRelativeMouseMode(SDL_TRUE);
-    mouse_x = 0;
-    mouse_y = 0;
+    init_frames();
+
+    return init_asset_loader();
+}
+
+// load font from glyphs that are already rasterized, see FC_LoadFontFromAtlas
+static void load_font_atlas(FC_Font * font, const font_atlas * atlas, SDL_Surface * surface, 
+                            TTF_Font * ttf, SDL_Color colour) {
+    FC_LoadFontFromAtlas(
+        font, renderer, surface, ttf, atlas->height_, atlas->ascent_, atlas->descent_, colour);
+    for (sc_uint g = 0; g < atlas->glyph_count_; g++) {
+        const font_atlas_glyph * glyph = &atlas->glyphs_[g];
+        FC_SetGlyphData(font, glyph->codepoint_, 
+            FC_MakeGlyphData(0, glyph->x_, glyph->y_, glyph->w_, glyph->h_));
+    }
+}
+
+// (re)create headless framebuffer and its software renderer, any loaded fonts 
+// are reloaded for the new renderer
+static sc_bool create_framebuffer(sc_int width, sc_int height, sc_int scale) {
+    if (renderer) {
+        // also destroys font and framebuffer textures
+        SDL_DestroyRenderer(renderer);
+        renderer = NULL;
+        fb_texture = NULL;
+        canvas = NULL;
+    }
+    if (framebuffer) {
+        SDL_FreeSurface(framebuffer);
+    }
+
+    framebuffer = SDL_CreateRGBSurfaceWithFormat(
+        0, width * scale, height * scale, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (framebuffer == NULL) {
+        sc_error("ERROR: headless framebuffer failed to initialise: %s\n", SDL_GetError());
+        return FALSE;
+    }
+
+    renderer = SDL_CreateSoftwareRenderer(framebuffer);
+    if (renderer == NULL) {
+        sc_error("ERROR: headless renderer failed to initialise: %s\n", SDL_GetError());
+        return FALSE;
+    }
+    SDL_RenderSetScale(renderer, scale, scale);
+
+    for (sc_int i = 0; i < MAX_FONTS; i++) {
+        if (fonts[i] == NULL) {
+            continue;
+        }
+        SDL_Color colour = FC_GetDefaultColor(fonts[i]);
+        FC_ResetFontFromRendererReset(fonts[i], renderer, SDL_RENDER_DEVICE_RESET);
+        if (font_rom_atlas[i] >= 0) {
+            // no TTF to reload glyphs from, so load atlas again
+            sc_int a = font_rom_atlas[i];
+            load_font_atlas(fonts[i], &atlases[a], atlas_surfaces[a], NULL, colour);
+        }
+    }
+    for (sc_int i = 0; i < MAX_IMAGES; i++) {
+        image_textures[i] = NULL;
+    }
+    if (text_runs) {
+        text_cache_invalidate(text_runs, -1);
+    }
+    return TRUE;
+}
+
+sc_bool init_headless_screen(const sc_char * frame_dir) {
+    // no video, events are still needed for SDL_PollEvent
+    if (SDL_Init(SDL_INIT_EVENTS) != 0) {
+        sc_error("ERROR: initializing SDL: %s\n", SDL_GetError());
+        return FALSE;
+    }
+
+    headless = TRUE;
+    frame_dump_dir = frame_dir;
+    lockstep = frame_dir != NULL;
+    init_frames();
+
+    return init_asset_loader() && create_framebuffer(window_width, window_height, 1);
+}
 
+sc_bool screen_frame_stats(screen_stats * dst) {
+    if (stats.frames_ == 0) {
+        return FALSE;
+    }
+    *dst = stats;
+    if (text_runs) {
+        dst->text_hits_ = text_runs->hits_;
+        dst->text_misses_ = text_runs->misses_;
+    }
+    dst->frame_period_ns_ = atomic_load(&frame_period_ns);
+    dst->vsync_ = vsync;
+    dst->frames_published_ = frames_published;
+    dst->frames_dropped_ = frames_published - stats.frames_;
+    dst->events_coalesced_ = mouse.coalesced_;
+    dst->events_dropped_ = mouse.dropped_ + keyboard.dropped_;
+
+    dst->framebuffer_hash_ = 0;
+    if (framebuffer && SDL_LockSurface(framebuffer) == 0) {
+        // FNV-1a, so runs can be compared without writing frames to disk
+        sc_uint hash = 2166136261u;
+        for (sc_int y = 0; y < framebuffer->h; y++) {
+            const sc_uchar * row = (const sc_uchar *)framebuffer->pixels + y * framebuffer->pitch;
+            for (sc_int x = 0; x < framebuffer->w * 4; x++) {
+                hash = (hash ^ row[x]) * 16777619u;
+            }
+        }
+        SDL_UnlockSurface(framebuffer);
+        dst->framebuffer_hash_ = hash;
+    }
     return TRUE;
 }
 
+//-------------------------------------------------------------------------------------
+// VM thread
+//-------------------------------------------------------------------------------------
+
+static draw_list * recording() {
+    return frames[recording_frame].commands_;
+}
+
+// add request for the render thread, waits if the queue is full
+static void push_request(const screen_request * request) {
+    sc_uint tail = atomic_load_explicit(&requests_tail, memory_order_relaxed);
+    while (tail - atomic_load_explicit(&requests_head, memory_order_acquire) >= MAX_REQUESTS) {
+        sleep_us(100);
+    }
+    requests[tail % MAX_REQUESTS] = *request;
+    atomic_store_explicit(&requests_tail, tail + 1, memory_order_release);
+}
+
 void screen_begin_frame() {
 }
 
 void screen_end_frame() {
-    SDL_RenderPresent(renderer);
-}
+    screen_frame * frame = &frames[recording_frame];
+    memcpy(frame->palette_, vm_palette, sizeof(vm_palette));
+    frame->retained_ = vm_retained;
+    frame->redraw_ = vm_redraw;
+    vm_redraw = FALSE;
 
-void screen_line(unsigned short x, unsigned short y) {
-    SDL_RenderDrawLine(renderer, screen_x, screen_y, x, y);
+    if (lockstep) {
+        while ((atomic_load(&ready_frame) & FRAME_FRESH) && !atomic_load(&quit)) {
+            sleep_us(100);
+        }
+    }
+
+    // publish, and take back whichever frame was waiting or last rendered
+    sc_uint previous = atomic_exchange(&ready_frame, recording_frame | FRAME_FRESH);
+    recording_frame = previous & ~FRAME_FRESH;
+    frames_published++;
+
+    // a dropped frame's redraw still needs to happen
+    if (previous & FRAME_FRESH && frames[recording_frame].redraw_) {
+        vm_redraw = TRUE;
+    }
+    draw_list_reset(frames[recording_frame].commands_);
 }
 
 void screen_pixel() {
-    SDL_RenderDrawPoint(renderer, screen_x, screen_y);
+    draw_list_pixel(recording(), colour_index, screen_x, screen_y);
 }
 
 void screen_fill() {
     // Clear winow
-    SDL_RenderClear( renderer );
+    draw_list_fill(recording(), colour_index);
 }
 
 void screen_colour(sc_uchar index) {
     colour_index = index;
-    colour c = colour_pallet[index];
-    SDL_SetRenderDrawColor( renderer, c.red_, c.green_, c.blue_, 255 ); 
 }
 
 void screen_move(sc_ushort x, sc_ushort y) {
@@ -131,61 +417,824 @@ void screen_move(sc_ushort x, sc_ushort y) {
 }
 
 void screen_rect(sc_ushort w, sc_ushort h) {
-    // Render rect
-    SDL_Rect r;
-    r.x = screen_x;
-    r.y = screen_y;
-    r.w = w;
-    r.h = h;
-    SDL_RenderFillRect( renderer, &r );
+    draw_list_rect(recording(), colour_index, screen_x, screen_y, w, h);
+}
+
+static void set_framebuffer(sc_uint * pixels, sc_uchar * indices, sc_ushort width, sc_ushort height) {
+    fb_pixels = pixels;
+    fb_indices = indices;
+    fb_width = width;
+    fb_height = height;
 }
 
-void screen_blit(sc_ushort x1, sc_ushort y1, sc_ushort x2, sc_ushort y2, sc_uchar *pixels) {
+void screen_framebuffer(sc_uint * pixels, sc_ushort width, sc_ushort height) {
+    set_framebuffer(pixels, NULL, width, height);
+}
 
+void screen_framebuffer_indexed(sc_uchar * indices, sc_ushort width, sc_ushort height) {
+    set_framebuffer(NULL, indices, width, height);
 }
 
-void screen_palette(void) {
+void screen_blit(sc_ushort x, sc_ushort y, sc_ushort w, sc_ushort h) {
+    if ((fb_pixels == NULL && fb_indices == NULL) || x >= fb_width || y >= fb_height) {
+        return;
+    }
+
+    // clip to framebuffer
+    if (x + w > fb_width) {
+        w = fb_width - x;
+    }
+    if (y + h > fb_height) {
+        h = fb_height - y;
+    }
 
+    // copy only the rows and columns of the rectangle, VM memory may change 
+    // before the frame is rendered, indexed framebuffers are expanded at render
+    if (fb_pixels) {
+        draw_list_blit(recording(), DRAW_BLIT, x, y, w, h, 
+                       fb_pixels + y * fb_width + x, fb_width * sizeof(sc_uint));
+    } else {
+        draw_list_blit(recording(), DRAW_BLIT_INDEXED, x, y, w, h, 
+                       fb_indices + y * fb_width + x, fb_width);
+    }
+}
+
+void screen_palette(const sc_uint * entries, sc_uint count) {
+    if (count > PALETTE_SIZE) {
+        count = PALETTE_SIZE;
+    }
+    for (sc_uint i = 0; i < count; i++) {
+        vm_palette[i] = entries[i];
+    }
 }
 
 void screen_resize(sc_ushort width, sc_ushort height, int scale) {
+    screen_request request;
+    request.kind_ = REQUEST_RESIZE;
+    request.width_ = width;
+    request.height_ = height;
+    request.scale_ = scale;
+    push_request(&request);
+}
+
+void screen_redraw(void) {
+    // next retained frame is drawn in full
+    vm_redraw = TRUE;
+}
+
+void screen_retain(sc_bool enable) {
+    vm_retained = enable;
+}
+
+static sc_int find_atlas(const sc_char * filename, sc_ushort point) {
+    for (sc_uint i = 0; i < atlas_count; i++) {
+        if (atlas_surfaces[i] && atlases[i].point_ == point && scmp(atlases[i].path_, filename, FONT_ATLAS_MAX_PATH)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// queue job for the asset loader, when frames are dumped wait for it, so 
+// every run dumps the same frames
+static void load_asset(asset_job * job, atomic_uint * pending) {
+    if (slen(job->path_) >= ASSET_MAX_PATH) {
+        sc_error("ERROR: asset path too long %s\n", job->path_);
+        return;
+    }
+    atomic_fetch_add(pending, 1);
+    asset_loader_push(job);
+    if (lockstep) {
+        while (atomic_load(pending) > 0 && !atomic_load(&quit)) {
+            sleep_us(100);
+        }
+    }
+}
+
+void screen_font(sc_ushort index, const sc_char * filename, sc_ushort point) {
+    if (index < MAX_FONTS && slen(filename) < ASSET_MAX_PATH) {
+        asset_job job;
+        job.kind_ = ASSET_FONT;
+        job.index_ = index;
+        job.point_ = point;
+        job.colour_ = vm_palette[colour_index];
+        job.rom_atlas_ = find_atlas(filename, point);
+        mcopy(filename, job.path_, slen(filename) + 1);
+        load_asset(&job, &font_pending[index]);
+    }
+}
+
+void screen_image(sc_ushort index, const sc_char * filename) {
+    if (index < MAX_IMAGES && slen(filename) < ASSET_MAX_PATH) {
+        asset_job job;
+        job.kind_ = ASSET_IMAGE;
+        job.index_ = index;
+        job.point_ = 0;
+        job.colour_ = 0;
+        job.rom_atlas_ = -1;
+        mcopy(filename, job.path_, slen(filename) + 1);
+        load_asset(&job, &image_pending[index]);
+    }
+}
+
+static sc_uint asset_status(atomic_uint * pending, atomic_uint * state) {
+    // state is written before pending is decremented
+    if (atomic_load(pending) > 0) {
+        return ASSET_LOADING;
+    }
+    return atomic_load(state);
+}
+
+sc_uint screen_font_status(sc_ushort index) {
+    return index < MAX_FONTS ? asset_status(&font_pending[index], &font_state[index]) : ASSET_FAILED;
+}
+
+sc_uint screen_image_status(sc_ushort index) {
+    return index < MAX_IMAGES ? asset_status(&image_pending[index], &image_state[index]) : ASSET_FAILED;
+}
+
+sc_bool screen_loading() {
+    return asset_loader_busy();
+}
+
+void screen_draw_image(sc_ushort index) {
+    draw_list_image(recording(), index, screen_x, screen_y);
+}
+
+void screen_text(sc_ushort index, const sc_char * str) {
+    draw_list_text(recording(), colour_index, index, screen_x, screen_y, str);
+}
+
+sc_bool attach_mouse_generator(sc_queue * queue, sc_uint rate, sc_uint flags) {
+    attach_generator(&mouse, queue, rate, flags);
+    return TRUE;
+}
+
+sc_bool attach_keyboard_generator(sc_queue * queue, sc_uint rate, sc_uint flags) {
+    attach_generator(&keyboard, queue, rate, flags);
+    return TRUE;
+}
+
+void screen_stop() {
+    atomic_store(&stop, TRUE);
+}
+
+//-------------------------------------------------------------------------------------
+// render thread
+//-------------------------------------------------------------------------------------
+
+static void resize(sc_int width, sc_int height, sc_int scale) {
     window_width = width;
     window_height = height;
-    mouse_x = 0; // window_width / 2;
-    mouse_y = 0; //window_height / 2;
+    screen_scale = scale;
+    full_damage = TRUE;
+    if (canvas) {
+        SDL_DestroyTexture(canvas);
+        canvas = NULL;
+    }
+    if (fb_texture) {
+        SDL_DestroyTexture(fb_texture);
+        fb_texture = NULL;
+    }
+    if (headless) {
+        create_framebuffer(width, height, scale);
+        return;
+    }
     SDL_RenderSetScale(renderer, scale,scale);
     SDL_SetWindowSize(window, width, height);
     SDL_ShowWindow(window);
 }
 
-void screen_redraw(void) {
+void screen_font_atlases(const font_atlas * baked, sc_uint count) {
+    atlases = baked;
+    atlas_count = count;
+    atlas_surfaces = (SDL_Surface**)calloc(count, sizeof(SDL_Surface*));
 
+    // expand coverage once, each font loaded from an atlas only uploads its surface
+    for (sc_uint i = 0; i < count; i++) {
+        atlas_surfaces[i] = font_atlas_surface(&atlases[i]);
+        if (atlas_surfaces[i] == NULL) {
+            sc_error("ERROR: could not create surface for font atlas %s\n", atlases[i].path_);
+        }
+    }
 }
 
-void screen_font(sc_ushort index, const sc_char * filename, sc_ushort point) {
-    if (index >= 0 && index < MAX_FONTS) {
-        FC_Font* font = FC_CreateFont();
-        colour c = colour_pallet[colour_index];
-        FC_LoadFont(
-            font, renderer, filename, point, FC_MakeColor(c.red_,c.green_,c.blue_,255), TTF_STYLE_NORMAL);
-        fonts[index] = font;
+static void set_font(sc_ushort index, FC_Font * font) {
+    if (fonts[index]) {
+        // may close its TTF
+        lock_fonts();
+        FC_FreeFont(fonts[index]);
+        unlock_fonts();
     }
+    fonts[index] = font;
+    text_cache_invalidate(text_runs, index);
+    full_damage = TRUE;
 }
 
-void screen_text(sc_ushort index, const sc_char * str) {
-    FC_Draw(fonts[index], renderer, screen_x, screen_y, str);
+// upload font decoded by the asset loader
+static sc_bool upload_font(asset_job * job) {
+    if (!job->ok_) {
+        return FALSE;
+    }
+    sc_uint c = job->colour_;
+    SDL_Color colour = FC_MakeColor(PALETTE_R(c), PALETTE_G(c), PALETTE_B(c), 255);
+    FC_Font * font = FC_CreateFont();
+    if (job->rom_atlas_ >= 0) {
+        // baked by scasm
+        load_font_atlas(font, &atlases[job->rom_atlas_], atlas_surfaces[job->rom_atlas_], NULL, colour);
+        stats.fonts_baked_++;
+    }
+    else {
+        // the font owns the TTF, for glyphs outside the atlas
+        load_font_atlas(font, &job->atlas_, job->surface_, job->ttf_, colour);
+        job->ttf_ = NULL;
+        stats.fonts_rasterized_++;
+    }
+    set_font(job->index_, font);
+    font_rom_atlas[job->index_] = job->rom_atlas_;
+    return TRUE;
+}
+
+static sc_bool upload_image(asset_job * job) {
+    sc_ushort index = job->index_;
+    if (image_textures[index]) {
+        SDL_DestroyTexture(image_textures[index]);
+        image_textures[index] = NULL;
+    }
+    SDL_FreeSurface(image_surfaces[index]);
+    image_surfaces[index] = NULL;
+    full_damage = TRUE;
+    if (!job->ok_) {
+        return FALSE;
+    }
+
+    // texture is made when the image is first drawn
+    image_surfaces[index] = job->surface_;
+    job->surface_ = NULL;
+    return TRUE;
+}
+
+static SDL_Texture * image_texture(sc_ushort index) {
+    if (image_textures[index] == NULL && image_surfaces[index]) {
+        image_textures[index] = SDL_CreateTextureFromSurface(renderer, image_surfaces[index]);
+        SDL_SetTextureBlendMode(image_textures[index], SDL_BLENDMODE_BLEND);
+    }
+    return image_textures[index];
+}
+
+// fonts and images decoded since last called, decoding happens on the asset loader's 
+// thread so all that is left is making textures
+static void process_assets() {
+    asset_job * job;
+    while ((job = asset_loader_peek()) != NULL) {
+        unsigned long long start = now_ns();
+        if (job->kind_ == ASSET_FONT) {
+            sc_bool ok = upload_font(job);
+            atomic_store(&font_state[job->index_], ok ? ASSET_READY : ASSET_FAILED);
+            atomic_fetch_sub(&font_pending[job->index_], 1);
+            stats.font_load_ns_ += now_ns() - start;
+        }
+        else {
+            sc_bool ok = upload_image(job);
+            atomic_store(&image_state[job->index_], ok ? ASSET_READY : ASSET_FAILED);
+            atomic_fetch_sub(&image_pending[job->index_], 1);
+            stats.images_loaded_ += ok;
+        }
+        asset_loader_pop();
+    }
+}
+
+static void process_requests() {
+    sc_uint head = atomic_load_explicit(&requests_head, memory_order_relaxed);
+    while (head != atomic_load_explicit(&requests_tail, memory_order_acquire)) {
+        const screen_request * request = &requests[head % MAX_REQUESTS];
+        switch (request->kind_) {
+            case REQUEST_RESIZE: {
+                resize(request->width_, request->height_, request->scale_);
+                break;
+            }
+        }
+        head++;
+        atomic_store_explicit(&requests_head, head, memory_order_release);
+    }
+    process_assets();
+}
+
+static void flush_batch() {
+    if (batch_points_count > 0) {
+        SDL_RenderDrawPoints(renderer, batch_points, batch_points_count);
+        batch_points_count = 0;
+        draw_calls++;
+    }
+    if (batch_rects_count > 0) {
+        SDL_RenderFillRects(renderer, batch_rects, batch_rects_count);
+        batch_rects_count = 0;
+        draw_calls++;
+    }
+}
+
+// upload blitted pixels into the screen sized texture, indexed pixels are expanded
+// with the current palette, returns false if the rectangle is off screen
+static sc_bool upload_blit(const draw_list * list, const draw_command * command, SDL_Rect * r) {
+    if (fb_texture == NULL) {
+        fb_texture = SDL_CreateTexture(
+            renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, window_width, window_height);
+        if (fb_texture == NULL) {
+            sc_error("ERROR: framebuffer texture failed to initialise: %s\n", SDL_GetError());
+            return FALSE;
+        }
+    }
+
+    // clip to screen, pixels are still w_ wide
+    r->x = command->x_;
+    r->y = command->y_;
+    r->w = command->w_;
+    r->h = command->h_;
+    if (r->x >= window_width || r->y >= window_height) {
+        return FALSE;
+    }
+    if (r->x + r->w > window_width) {
+        r->w = window_width - r->x;
+    }
+    if (r->y + r->h > window_height) {
+        r->h = window_height - r->y;
+    }
+
+    if (command->kind_ == DRAW_BLIT) {
+        SDL_UpdateTexture(fb_texture, r, draw_command_pixels(list, command), command->w_ * sizeof(sc_uint));
+        return TRUE;
+    }
+
+    void * pixels;
+    sc_int pitch;
+    if (SDL_LockTexture(fb_texture, r, &pixels, &pitch) != 0) {
+        return FALSE;
+    }
+    const sc_uchar * indices = (const sc_uchar *)draw_command_pixels(list, command);
+    for (sc_int row = 0; row < r->h; row++) {
+        palette_expand(
+            indices + row * command->w_, 
+            (sc_uint*)((sc_uchar*)pixels + row * pitch), 
+            r->w, 
+            palette);
+    }
+    SDL_UnlockTexture(fb_texture);
+    return TRUE;
+}
+
+// draw commands in order, consecutive pixels and rects of the same colour are 
+// submitted together, as they cannot overlap anything of a different colour 
+// this does not change what is drawn
+static void replay(const draw_list * list) {
+    sc_int current_colour = -1;
+    draw_calls = 0;
+
+    for (sc_uint i = 0; i < list->count_; i++) {
+        const draw_command * command = &list->commands_[i];
+
+        if (command->kind_ <= DRAW_RECT && command->colour_ != current_colour) {
+            flush_batch();
+            sc_uint c = palette[command->colour_];
+            SDL_SetRenderDrawColor(renderer, PALETTE_R(c), PALETTE_G(c), PALETTE_B(c), 255);
+            current_colour = command->colour_;
+        }
+
+        switch (command->kind_) {
+            case DRAW_FILL: {
+                // unlike SDL_RenderClear this respects the clip rect, see render_retained
+                SDL_RenderFillRect(renderer, NULL);
+                draw_calls++;
+                break;
+            }
+            case DRAW_PIXEL: {
+                if (batch_points_count == MAX_BATCH) {
+                    flush_batch();
+                }
+                SDL_Point * p = &batch_points[batch_points_count++];
+                p->x = command->x_;
+                p->y = command->y_;
+                break;
+            }
+            case DRAW_RECT: {
+                if (batch_rects_count == MAX_BATCH) {
+                    flush_batch();
+                }
+                SDL_Rect * r = &batch_rects[batch_rects_count++];
+                r->x = command->x_;
+                r->y = command->y_;
+                r->w = command->w_;
+                r->h = command->h_;
+                break;
+            }
+            case DRAW_TEXT: {
+                flush_batch();
+                if (command->font_ < MAX_FONTS) {
+                    const sc_char * text = draw_command_text(list, command);
+                    FC_Font * font = fonts[command->font_];
+                    const text_run * run = text_cache_get(text_runs, command->font_, font, text);
+                    draw_calls += text_cache_draw(text_runs, renderer, font, run, command->x_, command->y_);
+                }
+                break;
+            }
+            case DRAW_BLIT:
+            case DRAW_BLIT_INDEXED: {
+                flush_batch();
+                SDL_Rect r;
+                if (upload_blit(list, command, &r)) {
+                    SDL_RenderCopy(renderer, fb_texture, &r, &r);
+                    draw_calls++;
+                }
+                break;
+            }
+            case DRAW_IMAGE: {
+                flush_batch();
+                SDL_Texture * texture = command->font_ < MAX_IMAGES ? image_texture(command->font_) : NULL;
+                if (texture) {
+                    SDL_Rect r = { command->x_, command->y_, 
+                                   image_surfaces[command->font_]->w, image_surfaces[command->font_]->h };
+                    SDL_RenderCopy(renderer, texture, NULL, &r);
+                    draw_calls++;
+                }
+                break;
+            }
+        }
+    }
+    flush_batch();
+}
+
+// area covered by command, in screen coordinates
+static void command_bounds(const draw_list * list, const draw_command * command, SDL_Rect * r) {
+    r->x = command->x_;
+    r->y = command->y_;
+    switch (command->kind_) {
+        case DRAW_FILL: {
+            r->x = 0;
+            r->y = 0;
+            r->w = window_width;
+            r->h = window_height;
+            break;
+        }
+        case DRAW_PIXEL: {
+            r->w = 1;
+            r->h = 1;
+            break;
+        }
+        case DRAW_TEXT: {
+            r->w = 0;
+            r->h = 0;
+            if (command->font_ < MAX_FONTS) {
+                const text_run * run = text_cache_get(
+                    text_runs, command->font_, fonts[command->font_], draw_command_text(list, command));
+                if (run) {
+                    r->w = run->w_;
+                    r->h = run->h_;
+                }
+            }
+            break;
+        }
+        case DRAW_IMAGE: {
+            const SDL_Surface * image = command->font_ < MAX_IMAGES ? image_surfaces[command->font_] : NULL;
+            r->w = image ? image->w : 0;
+            r->h = image ? image->h : 0;
+            break;
+        }
+        default: {
+            r->w = command->w_;
+            r->h = command->h_;
+            break;
+        }
+    }
+}
+
+static sc_bool commands_equal(const draw_list * a, const draw_command * ca, 
+                              const draw_list * b, const draw_command * cb) {
+    if (ca->kind_ != cb->kind_ || ca->x_ != cb->x_ || ca->y_ != cb->y_) {
+        return FALSE;
+    }
+    switch (ca->kind_) {
+        case DRAW_FILL:
+        case DRAW_PIXEL:
+            return ca->colour_ == cb->colour_;
+        case DRAW_RECT:
+            return ca->colour_ == cb->colour_ && ca->w_ == cb->w_ && ca->h_ == cb->h_;
+        case DRAW_TEXT: {
+            const sc_char * ta = draw_command_text(a, ca);
+            const sc_char * tb = draw_command_text(b, cb);
+            return ca->font_ == cb->font_ && scmp(ta, tb, slen(ta) + 1);
+        }
+        case DRAW_IMAGE:
+            return ca->font_ == cb->font_;
+        default: {
+            // blits, pixels were copied into the frame, so compare them
+            if (ca->w_ != cb->w_ || ca->h_ != cb->h_) {
+                return FALSE;
+            }
+            sc_uint length = ca->w_ * ca->h_ * (ca->kind_ == DRAW_BLIT ? sizeof(sc_uint) : 1);
+            return memcmp(draw_command_pixels(a, ca), draw_command_pixels(b, cb), length) == 0;
+        }
+    }
+}
+
+static void add_damage(SDL_Rect * damage, const SDL_Rect * r) {
+    if (r->w <= 0 || r->h <= 0) {
+        return;
+    }
+    if (damage->w <= 0 || damage->h <= 0) {
+        *damage = *r;
+    } else {
+        SDL_UnionRect(damage, r, damage);
+    }
+}
+
+// area that differs between this frame and the last presented frame, 
+// commands are compared in order, so a pixel outside of the damage is 
+// covered by exactly the same commands in both frames
+static void frame_damage(const draw_list * commands, SDL_Rect * damage) {
+    damage->x = 0;
+    damage->y = 0;
+    damage->w = 0;
+    damage->h = 0;
+
+    if (full_damage) {
+        damage->w = window_width;
+        damage->h = window_height;
+        return;
+    }
+
+    sc_uint count = commands->count_ > last_commands->count_ ? 
+        commands->count_ : last_commands->count_;
+    for (sc_uint i = 0; i < count; i++) {
+        const draw_command * c = i < commands->count_ ? &commands->commands_[i] : NULL;
+        const draw_command * l = i < last_commands->count_ ? &last_commands->commands_[i] : NULL;
+        if (c && l && commands_equal(commands, c, last_commands, l)) {
+            continue;
+        }
+
+        SDL_Rect r;
+        if (c) {
+            command_bounds(commands, c, &r);
+            add_damage(damage, &r);
+        }
+        if (l) {
+            command_bounds(last_commands, l, &r);
+            add_damage(damage, &r);
+        }
+    }
+
+    SDL_Rect screen = { 0, 0, window_width, window_height };
+    if (!SDL_IntersectRect(damage, &screen, damage)) {
+        damage->w = 0;
+        damage->h = 0;
+    }
+}
+
+// redraw damaged area only, returns false if nothing changed
+static sc_bool render_retained(const draw_list * commands) {
+    SDL_Rect damage;
+    frame_damage(commands, &damage);
+    stats.damage_pixels_last_ = damage.w * damage.h;
+    if (damage.w <= 0 || damage.h <= 0) {
+        draw_calls = 0;
+        return FALSE;
+    }
+
+    if (!headless) {
+        // the back buffer is not kept between presents, so draw into a canvas 
+        if (canvas == NULL) {
+            canvas = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, 
+                SDL_TEXTUREACCESS_TARGET, window_width * screen_scale, window_height * screen_scale);
+            if (canvas == NULL) {
+                sc_error("ERROR: canvas failed to initialise: %s\n", SDL_GetError());
+                replay(commands);
+                return TRUE;
+            }
+        }
+        SDL_SetRenderTarget(renderer, canvas);
+        SDL_RenderSetScale(renderer, screen_scale, screen_scale);
+    }
+
+    SDL_RenderSetClipRect(renderer, &damage);
+    replay(commands);
+    SDL_RenderSetClipRect(renderer, NULL);
+
+    if (!headless) {
+        SDL_SetRenderTarget(renderer, NULL);
+        SDL_RenderCopy(renderer, canvas, NULL, NULL);
+        draw_calls++;
+    }
+
+    full_damage = FALSE;
+    return TRUE;
+}
+
+static void render(const screen_frame * frame) {
+    unsigned long long begin_ns = now_ns();
+
+    if (memcmp(palette, frame->palette_, sizeof(palette)) != 0) {
+        memcpy(palette, frame->palette_, sizeof(palette));
+        full_damage = TRUE;
+    }
+    if (frame->redraw_ || frame->retained_ != retained) {
+        full_damage = TRUE;
+    }
+    retained = frame->retained_;
+
+    const draw_list * commands = frame->commands_;
+    stats.draw_commands_last_ = commands->count_;
+
+    sc_bool present = TRUE;
+    if (retained) {
+        present = render_retained(commands);
+
+        // keep this frame to compare with the next, the frame itself goes back 
+        // to the VM thread
+        draw_list_copy(last_commands, commands);
+        if (!present) {
+            stats.frames_skipped_++;
+        }
+    } else {
+        replay(commands);
+        stats.damage_pixels_last_ = window_width * window_height;
+    }
+    stats.draw_calls_last_ = draw_calls;
+
+    if (present) {
+        SDL_RenderPresent(renderer);
+    }
+
+    if (frame_dump_dir && framebuffer) {
+        sc_char path[1024];
+        snprintf(path, sizeof(path), "%s/frame_%06llu.bmp", frame_dump_dir, stats.frames_);
+        if (SDL_SaveBMP(framebuffer, path) != 0) {
+            sc_error("ERROR: could not write frame %s: %s\n", path, SDL_GetError());
+        }
+    }
+
+    unsigned long long frame_ns = now_ns() - begin_ns;
+    stats.frames_++;
+    stats.frame_ns_last_ = frame_ns;
+    stats.frame_ns_total_ += frame_ns;
+    if (stats.frames_ == 1 || frame_ns < stats.frame_ns_min_) {
+        stats.frame_ns_min_ = frame_ns;
+    }
+    if (frame_ns > stats.frame_ns_max_) {
+        stats.frame_ns_max_ = frame_ns;
+    }
+}
+
+// render latest published frame, returns false if there was none
+static sc_bool render_ready_frame() {
+    if (!(atomic_load(&ready_frame) & FRAME_FRESH)) {
+        return FALSE;
+    }
+    sc_uint previous = atomic_exchange(&ready_frame, presenting_frame);
+    presenting_frame = previous & ~FRAME_FRESH;
+
+    // requests are made before the frames that depend on them are published
+    process_requests();
+    render(&frames[presenting_frame]);
+    return TRUE;
+}
+
+// time between rendered frames, as seen on screen
+static void record_interval(unsigned long long now) {
+    if (last_frame_ns != 0) {
+        unsigned long long interval = now - last_frame_ns;
+        stats.interval_ns_last_ = interval;
+        stats.interval_ns_total_ += interval;
+        if (stats.interval_ns_min_ == 0 || interval < stats.interval_ns_min_) {
+            stats.interval_ns_min_ = interval;
+        }
+        if (interval > stats.interval_ns_max_) {
+            stats.interval_ns_max_ = interval;
+        }
+    }
+    last_frame_ns = now;
+}
+
+void screen_run() {
+    while (!atomic_load(&stop)) {
+        screen_process_events();
+        process_requests();
+
+        unsigned long long period = atomic_load(&frame_period_ns);
+        unsigned long long now = now_ns();
+        if (period > 0 && now < next_frame_ns) {
+            // not due yet, wake up often enough to keep handling events
+            unsigned long long wait = next_frame_ns - now;
+            sleep_us(wait > 1000000 ? 1000 : wait / 1000);
+            continue;
+        }
+
+        if (!render_ready_frame()) {
+            sleep_us(500);
+            continue;
+        }
+
+        unsigned long long end = now_ns();
+        record_interval(end);
+        if (period > 0) {
+            // deadlines are kept on a fixed grid, unless no frame was ready for 
+            // a whole period, then the grid starts again from this frame
+            if (next_frame_ns == 0 || now - next_frame_ns > period) {
+                next_frame_ns = now;
+            }
+            next_frame_ns += period;
+
+            // rendering took longer than a period, better to skip than to 
+            // render a burst of frames to catch up
+            if (end > next_frame_ns) {
+                stats.frames_late_++;
+                next_frame_ns = end + period;
+            }
+        }
+    }
+
+    // VM has finished, render anything it left behind
+    render_ready_frame();
+    process_requests();
+}
+
+static sc_uint key_word(const SDL_KeyboardEvent * key) {
+    sc_uint word = KEY_EVENT | (key->keysym.scancode & 0xFFFF);
+    if (key->state == SDL_PRESSED) {
+        word |= KEY_DOWN;
+    }
+    if (key->repeat) {
+        word |= KEY_REPEAT;
+    }
+    sc_uint mod = key->keysym.mod;
+    if (mod & KMOD_SHIFT) {
+        word |= KEY_MOD_SHIFT;
+    }
+    if (mod & KMOD_CTRL) {
+        word |= KEY_MOD_CTRL;
+    }
+    if (mod & KMOD_ALT) {
+        word |= KEY_MOD_ALT;
+    }
+    if (mod & KMOD_GUI) {
+        word |= KEY_MOD_GUI;
+    }
+    if (mod & KMOD_CAPS) {
+        word |= KEY_MOD_CAPS;
+    }
+    return word;
+}
+
+// decode one UTF-8 codepoint, returns NULL at the end of str, invalid bytes are skipped
+static const sc_uchar * next_codepoint(const sc_uchar * str, sc_uint * codepoint) {
+    while (*str) {
+        sc_uchar c = *str++;
+        sc_int extra = c < 0x80 ? 0 : (c & 0xE0) == 0xC0 ? 1 : (c & 0xF0) == 0xE0 ? 2 : (c & 0xF8) == 0xF0 ? 3 : -1;
+        if (extra < 0) {
+            continue;
+        }
+        sc_uint value = extra == 0 ? c : c & (0x3F >> extra);
+        sc_int i = 0;
+        for (; i < extra && (str[i] & 0xC0) == 0x80; i++) {
+            value = (value << 6) | (str[i] & 0x3F);
+        }
+        str += i;
+        if (i == extra) {
+            *codepoint = value;
+            return str;
+        }
+    }
+    return NULL;
 }
 
 sc_bool screen_process_events() {
     SDL_Event e;
+    sc_bool has_mouse = generator_attached(&mouse);
+    sc_bool has_keyboard = generator_attached(&keyboard);
+    unsigned long long now = now_ns();
     while (SDL_PollEvent(&e)){
         switch (e.type) {
             case SDL_QUIT: {
-                quit = TRUE;
+                atomic_store(&quit, TRUE);
                 break;
             }
-            case SDL_KEYDOWN: {
-                quit = TRUE;
+            case SDL_KEYDOWN:
+            case SDL_KEYUP: {
+                if (has_keyboard) {
+                    generator_event(&keyboard, key_word(&e.key));
+                }
+                else if (e.type == SDL_KEYDOWN) {
+                    // nothing is listening, so any key closes the window
+                    atomic_store(&quit, TRUE);
+                }
+                break;
+            }
+            case SDL_TEXTINPUT: {
+                if (has_keyboard) {
+                    // one word per codepoint
+                    const sc_uchar * c = (const sc_uchar*)e.text.text;
+                    sc_uint codepoint;
+                    while ((c = next_codepoint(c, &codepoint)) != NULL) {
+                        generator_event(&keyboard, KEY_EVENT | KEY_TEXT | codepoint);
+                    }
+                }
                 break;
             }
             // mouse events are handled via a single 32-bit uint
@@ -195,43 +1244,78 @@ sc_bool screen_process_events() {
             //     top 16-bits represent x
             //     bottom 16-bits represent y
             case SDL_MOUSEBUTTONDOWN: {
-                if (mouse_queue) {
+                if (has_mouse) {
                     SDL_MouseButtonEvent b = e.button;
                     sc_uint v = ((sc_ushort)b.button) | 0x80000000; // set top bit
-                    enqueue(mouse_queue, v);
+                    generator_event(&mouse, v);
                 }
                 break;
             }
             case SDL_MOUSEMOTION: {
-                if (mouse_queue) {
+                if (has_mouse) {
                     sc_ushort mouse_x = e.motion.x;
                     sc_ushort mouse_y = e.motion.y;
                     sc_uint v = (mouse_x << 16 | mouse_y) & 0x7FFFFFFF; 
                     // top bit is cleared for mouse move, this should not actually be necessary...
-                    enqueue(mouse_queue, v);
+                    // only the latest position is sent each period of the stream
+                    generator_sample(&mouse, v, now);
                 }
                 break;
                 // top 2 bits 
                 // 00 => mouse motion
                 // 01 => reserved
                 // 10 => button press
-                // 11 => keyboard 
+                // 11 => keyboard, see KEY_EVENT
             }
             default:
                 break;    
         }
     }
-    return quit;
-}
-
-sc_bool attach_mouse_generator(sc_queue * queue) {
-    mouse_queue = queue;
-    return TRUE;
+    // position held back from an earlier call may now be due
+    generator_tick(&mouse, now);
+    return atomic_load(&quit);
 }
 
 sc_bool delete_screen() {
+    for (sc_int i = 0; i < NUM_FRAMES; i++) {
+        delete_draw_list(frames[i].commands_);
+        frames[i].commands_ = NULL;
+    }
+    delete_draw_list(last_commands);
+    last_commands = NULL;
+    delete_asset_loader();
+    delete_text_cache(text_runs);
+    text_runs = NULL;
+    for (sc_int i = 0; i < MAX_IMAGES; i++) {
+        if (image_textures[i]) {
+            SDL_DestroyTexture(image_textures[i]);
+            image_textures[i] = NULL;
+        }
+        SDL_FreeSurface(image_surfaces[i]);
+        image_surfaces[i] = NULL;
+    }
+    for (sc_uint i = 0; i < atlas_count; i++) {
+        SDL_FreeSurface(atlas_surfaces[i]);
+    }
+    free(atlas_surfaces);
+    atlas_surfaces = NULL;
+    atlas_count = 0;
+    if (canvas) {
+        SDL_DestroyTexture(canvas);
+        canvas = NULL;
+    }
+    if (fb_texture) {
+        SDL_DestroyTexture(fb_texture);
+        fb_texture = NULL;
+    }
     SDL_DestroyRenderer(renderer);
-    SDL_DestroyWindow(window);
+    if (framebuffer) {
+        SDL_FreeSurface(framebuffer);
+        framebuffer = NULL;
+    }
+    if (window) {
+        SDL_DestroyWindow(window);
+    }
     SDL_Quit();
     return TRUE;
 }
@@ -0,0 +1,312 @@
+/* This file is part of {{ samplecontrol }}.
+ *
+ * 2024 Benedict R. Gaster (cuberoo_)
+ *
+ * Licensed under either of
+ * Apache License, Version 2.0 (LICENSE-APACHE or http://www.apache.org/licenses/LICENSE-2.0)
+ * MIT license (LICENSE-MIT or http://opensource.org/licenses/MIT)
+ * at your option.
+ */
+
+#include <telemetry.h>
+
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+//-----------------------------------------------------------------------------------------------
+// Globals
+//-----------------------------------------------------------------------------------------------
+
+static sc_bool enabled = FALSE;
+static sc_bool registered[TELEMETRY_MAX_TASKS] = { FALSE };
+static telemetry_task_stats stats[TELEMETRY_MAX_TASKS];
+
+static const long long jitter_bounds_us[TELEMETRY_JITTER_BUCKETS-1] = TELEMETRY_JITTER_BOUNDS_US;
+
+static FILE * file = NULL;
+static sc_int socket_fd = -1;
+static struct sockaddr_un socket_addr;
+
+static unsigned long long interval_ns = 0;
+static unsigned long long last_publish_ns = 0;
+
+// stats are copied into a ring of snapshots by the VM thread, which a writer thread
+// formats and writes out, so the VM never waits on the file
+#define TELEMETRY_SNAPSHOTS 4
+
+typedef struct {
+    unsigned long long time_ns_;
+    sc_uint count_;
+    telemetry_task_stats tasks_[TELEMETRY_MAX_TASKS];
+} telemetry_snapshot;
+
+static telemetry_snapshot snapshots[TELEMETRY_SNAPSHOTS];
+static atomic_uint snapshots_head = 0;  // next to write out, writer thread
+static atomic_uint snapshots_tail = 0;  // next free, VM thread
+static unsigned long long dropped = 0;  // ring was full
+
+static pthread_t writer;
+static sc_bool running = FALSE;
+static sc_bool stopping = FALSE;
+static pthread_mutex_t writer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t writer_wake = PTHREAD_COND_INITIALIZER;
+
+//-----------------------------------------------------------------------------------------------
+//-----------------------------------------------------------------------------------------------
+
+static void write_stats(unsigned long long now_ns, const telemetry_task_stats * s) {
+    sc_char buffer[1024];
+    sc_int length = snprintf(buffer, sizeof(buffer),
+        "{\"time_ns\":%llu,\"task\":%u,\"rate\":%u,\"budget_ns\":%llu,\"periods\":%llu,"
+        "\"overruns\":%llu,\"deadline_misses\":%llu,"
+        "\"cpu_ns_last\":%llu,\"cpu_ns_max\":%llu,\"cpu_ns_avg\":%llu,\"utilization\":%.4f,"
+        "\"instructions_last\":%llu,\"instructions_max\":%llu,\"instructions_avg\":%llu,"
+        "\"jitter_ns_last\":%lld,\"jitter_ns_max\":%lld,\"jitter_histogram\":[",
+        now_ns, s->task_id_, s->rate_, s->budget_ns_, s->periods_,
+        s->overruns_, s->deadline_misses_,
+        s->cpu_ns_last_, s->cpu_ns_max_, s->periods_ ? s->cpu_ns_total_ / s->periods_ : 0,
+        s->budget_ns_ && s->periods_ ? (double)s->cpu_ns_total_ / s->periods_ / s->budget_ns_ : 0.0,
+        s->instructions_last_, s->instructions_max_,
+        s->periods_ ? s->instructions_total_ / s->periods_ : 0,
+        s->jitter_ns_last_, s->jitter_ns_max_);
+    for (sc_int b = 0; b < TELEMETRY_JITTER_BUCKETS && length < sizeof(buffer); b++) {
+        length += snprintf(buffer + length, sizeof(buffer) - length, "%s%llu",
+            b > 0 ? "," : "", s->jitter_histogram_[b]);
+    }
+    if (length < sizeof(buffer)) {
+        length += snprintf(buffer + length, sizeof(buffer) - length, "]}\n");
+    }
+    if (length >= sizeof(buffer)) {
+        length = sizeof(buffer) - 1;
+    }
+
+    if (file) {
+        fwrite(buffer, 1, length, file);
+    }
+    else if (socket_fd >= 0) {
+        // drop stats if no one is listening
+        sendto(socket_fd, buffer, length, MSG_DONTWAIT,
+               (struct sockaddr*)&socket_addr, sizeof(socket_addr));
+    }
+}
+
+static void write_snapshot(const telemetry_snapshot * snapshot) {
+    for (sc_uint i = 0; i < snapshot->count_; i++) {
+        write_stats(snapshot->time_ns_, &snapshot->tasks_[i]);
+    }
+    if (file) {
+        fflush(file);
+    }
+}
+
+static void * writer_thread(void * unused) {
+    sc_uint head = atomic_load_explicit(&snapshots_head, memory_order_relaxed);
+    for (;;) {
+        pthread_mutex_lock(&writer_lock);
+        while (!stopping && head == atomic_load_explicit(&snapshots_tail, memory_order_acquire)) {
+            pthread_cond_wait(&writer_wake, &writer_lock);
+        }
+        sc_bool stop = stopping;
+        pthread_mutex_unlock(&writer_lock);
+
+        // write out everything queued, even when stopping
+        sc_uint tail = atomic_load_explicit(&snapshots_tail, memory_order_acquire);
+        while (head != tail) {
+            write_snapshot(&snapshots[head % TELEMETRY_SNAPSHOTS]);
+            head++;
+            atomic_store_explicit(&snapshots_head, head, memory_order_release);
+        }
+        if (stop) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+sc_bool enable_telemetry(const sc_char * target, sc_uint interval_ms) {
+    if (scmp(target, "unix:", 5)) {
+        const sc_char * path = target + 5;
+        if (slen(path) >= sizeof(socket_addr.sun_path)) {
+            sc_error("ERROR: telemetry socket path too long %s\n", path);
+            return FALSE;
+        }
+
+        socket_fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+        if (socket_fd < 0) {
+            sc_error("ERROR: could not create telemetry socket\n");
+            return FALSE;
+        }
+        memset(&socket_addr, 0, sizeof(socket_addr));
+        socket_addr.sun_family = AF_UNIX;
+        strcpy(socket_addr.sun_path, path);
+    }
+    else {
+        file = fopen(target, "w");
+        if (file == NULL) {
+            sc_error("ERROR: could not open telemetry file %s\n", target);
+            return FALSE;
+        }
+    }
+
+    stopping = FALSE;
+    if (pthread_create(&writer, NULL, writer_thread, NULL) != 0) {
+        sc_error("ERROR: could not create telemetry thread\n");
+        return FALSE;
+    }
+    running = TRUE;
+
+    interval_ns = (unsigned long long)interval_ms * 1000000ULL;
+    enabled = TRUE;
+    atexit(delete_telemetry);
+    return TRUE;
+}
+
+void telemetry_task(sc_uint task_id, sc_uint rate) {
+    if (task_id >= TELEMETRY_MAX_TASKS) {
+        return;
+    }
+    memset(&stats[task_id], 0, sizeof(telemetry_task_stats));
+    stats[task_id].task_id_ = task_id;
+    stats[task_id].rate_ = rate;
+    stats[task_id].budget_ns_ = rate > 0 ? 1000000000ULL / rate : 0;
+    registered[task_id] = TRUE;
+}
+
+void telemetry_period(sc_uint task_id, unsigned long long cpu_ns,
+                      unsigned long long instructions, sc_bool missed_deadline) {
+    if (!enabled || task_id >= TELEMETRY_MAX_TASKS) {
+        return;
+    }
+    telemetry_task_stats * s = &stats[task_id];
+
+    s->periods_++;
+    s->cpu_ns_last_ = cpu_ns;
+    s->cpu_ns_total_ += cpu_ns;
+    if (cpu_ns > s->cpu_ns_max_) {
+        s->cpu_ns_max_ = cpu_ns;
+    }
+    if (s->budget_ns_ > 0 && cpu_ns > s->budget_ns_) {
+        s->overruns_++;
+    }
+    if (missed_deadline) {
+        s->deadline_misses_++;
+    }
+
+    s->instructions_last_ = instructions;
+    s->instructions_total_ += instructions;
+    if (instructions > s->instructions_max_) {
+        s->instructions_max_ = instructions;
+    }
+}
+
+void telemetry_wakeup(sc_uint task_id, long long jitter_ns) {
+    if (!enabled || task_id >= TELEMETRY_MAX_TASKS) {
+        return;
+    }
+    telemetry_task_stats * s = &stats[task_id];
+
+    s->jitter_ns_last_ = jitter_ns;
+    if (jitter_ns > s->jitter_ns_max_) {
+        s->jitter_ns_max_ = jitter_ns;
+    }
+
+    sc_int bucket = 0;
+    while (bucket < TELEMETRY_JITTER_BUCKETS-1 && jitter_ns > jitter_bounds_us[bucket] * 1000) {
+        bucket++;
+    }
+    s->jitter_histogram_[bucket]++;
+}
+
+sc_bool telemetry_stats(sc_uint task_id, telemetry_task_stats * dst) {
+    if (task_id >= TELEMETRY_MAX_TASKS || !registered[task_id]) {
+        return FALSE;
+    }
+    *dst = stats[task_id];
+    return TRUE;
+}
+
+// copy stats for the writer thread, dropping them if it has fallen behind
+static void publish_stats(unsigned long long now_ns) {
+    sc_uint tail = atomic_load_explicit(&snapshots_tail, memory_order_relaxed);
+    if (tail - atomic_load_explicit(&snapshots_head, memory_order_acquire) >= TELEMETRY_SNAPSHOTS) {
+        // window values are kept, so they carry into the next snapshot
+        dropped++;
+        return;
+    }
+
+    telemetry_snapshot * snapshot = &snapshots[tail % TELEMETRY_SNAPSHOTS];
+    snapshot->time_ns_ = now_ns;
+    snapshot->count_ = 0;
+    for (sc_uint id = 0; id < TELEMETRY_MAX_TASKS; id++) {
+        if (!registered[id]) {
+            continue;
+        }
+        telemetry_task_stats * s = &stats[id];
+        snapshot->tasks_[snapshot->count_++] = *s;
+
+        // reset window values
+        s->cpu_ns_max_ = 0;
+        s->instructions_max_ = 0;
+        s->jitter_ns_max_ = 0;
+    }
+
+    pthread_mutex_lock(&writer_lock);
+    atomic_store_explicit(&snapshots_tail, tail + 1, memory_order_release);
+    pthread_cond_signal(&writer_wake);
+    pthread_mutex_unlock(&writer_lock);
+}
+
+void telemetry_publish(unsigned long long now_ns) {
+    if (!enabled) {
+        return;
+    }
+    if (now_ns - last_publish_ns >= interval_ns) {
+        publish_stats(now_ns);
+        last_publish_ns = now_ns;
+    }
+}
+
+void delete_telemetry() {
+    if (!enabled) {
+        return;
+    }
+    if (running) {
+        pthread_mutex_lock(&writer_lock);
+        stopping = TRUE;
+        pthread_cond_signal(&writer_wake);
+        pthread_mutex_unlock(&writer_lock);
+        pthread_join(writer, NULL);
+        running = FALSE;
+    }
+
+    // writer has stopped, so final stats are written directly
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    telemetry_snapshot * snapshot = &snapshots[0];
+    snapshot->time_ns_ = now.tv_sec * 1000000000ULL + now.tv_nsec;
+    snapshot->count_ = 0;
+    for (sc_uint id = 0; id < TELEMETRY_MAX_TASKS; id++) {
+        if (registered[id]) {
+            snapshot->tasks_[snapshot->count_++] = stats[id];
+        }
+    }
+    write_snapshot(snapshot);
+    enabled = FALSE;
+    if (dropped > 0) {
+        sc_error("WARNING: telemetry writer fell behind, %llu snapshots lost\n", dropped);
+    }
+
+    if (file) {
+        fclose(file);
+        file = NULL;
+    }
+    if (socket_fd >= 0) {
+        close(socket_fd);
+        socket_fd = -1;
+    }
+}
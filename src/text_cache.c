@@ -0,0 +1,224 @@
+/* This file is part of {{ samplecontrol }}.
+ *
+ * 2024 Benedict R. Gaster (cuberoo_)
+ *
+ * Licensed under either of
+ * Apache License, Version 2.0 (LICENSE-APACHE or http://www.apache.org/licenses/LICENSE-2.0)
+ * MIT license (LICENSE-MIT or http://opensource.org/licenses/MIT)
+ * at your option.
+ */
+
+#include <text_cache.h>
+
+#include <string.h>
+
+// SDL_RenderGeometry is only available from SDL 2.0.18, before that each glyph is copied
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+ #define USE_GEOMETRY 1
+#else
+ #define USE_GEOMETRY 0
+#endif
+
+text_cache * allocate_text_cache(sc_uint size) {
+    text_cache * cache = (text_cache*)malloc(sizeof(text_cache));
+    cache->runs_ = (text_run*)calloc(size, sizeof(text_run));
+    cache->size_ = size;
+    cache->hits_ = 0;
+    cache->misses_ = 0;
+    cache->scratch_ = NULL;
+    cache->scratch_capacity_ = 0;
+    cache->indices_ = NULL;
+    cache->indices_capacity_ = 0;
+    return cache;
+}
+
+static void free_run(text_run * run) {
+    free(run->text_);
+    free(run->vertices_);
+    free(run->levels_);
+    memset(run, 0, sizeof(text_run));
+}
+
+void delete_text_cache(text_cache * cache) {
+    if (cache) {
+        text_cache_invalidate(cache, -1);
+        free(cache->runs_);
+        free(cache->scratch_);
+        free(cache->indices_);
+        free(cache);
+    }
+}
+
+void text_cache_invalidate(text_cache * cache, sc_int font_index) {
+    for (sc_uint i = 0; i < cache->size_; i++) {
+        text_run * run = &cache->runs_[i];
+        if (run->text_ && (font_index < 0 || run->font_ == font_index)) {
+            free_run(run);
+        }
+    }
+}
+
+// FNV-1a of font and text
+static sc_uint hash_text(sc_ushort font_index, const sc_char * text, sc_uint * length) {
+    sc_uint hash = (2166136261u ^ font_index) * 16777619u;
+    const sc_char * c = text;
+    while (*c) {
+        hash = (hash ^ (sc_uchar)*c++) * 16777619u;
+    }
+    *length = c - text;
+    return hash;
+}
+
+// lay out text into run, glyphs are grouped by glyph cache texture
+static void layout(text_run * run, FC_Font * font, const sc_char * text) {
+    FC_Rect bounds;
+    sc_int count = FC_GetGlyphQuads(font, text, NULL, 0, &bounds);
+    run->w_ = bounds.x + bounds.w;
+    run->h_ = bounds.y + bounds.h;
+    if (count <= 0) {
+        return;
+    }
+
+    FC_GlyphQuad * glyphs = (FC_GlyphQuad*)malloc(count * sizeof(FC_GlyphQuad));
+    FC_GetGlyphQuads(font, text, glyphs, count, NULL);
+
+    sc_int max_level = 0;
+    for (sc_int i = 0; i < count; i++) {
+        if (glyphs[i].cache_level > max_level) {
+            max_level = glyphs[i].cache_level;
+        }
+    }
+
+    run->vertices_ = (SDL_Vertex*)malloc(count * 4 * sizeof(SDL_Vertex));
+    run->levels_ = (text_run_level*)malloc((max_level + 1) * sizeof(text_run_level));
+    SDL_Color white = { 255, 255, 255, 255 };
+
+    for (sc_int level = 0; level <= max_level; level++) {
+        sc_int w, h;
+        SDL_Texture * texture = FC_GetGlyphCacheLevel(font, level);
+        if (texture == NULL || SDL_QueryTexture(texture, NULL, NULL, &w, &h) != 0) {
+            continue;
+        }
+
+        text_run_level * l = &run->levels_[run->level_count_];
+        l->cache_level_ = level;
+        l->first_ = run->quads_;
+        l->count_ = 0;
+
+        for (sc_int i = 0; i < count; i++) {
+            const FC_GlyphQuad * g = &glyphs[i];
+            if (g->cache_level != level) {
+                continue;
+            }
+            float x0 = g->dst.x, y0 = g->dst.y;
+            float x1 = g->dst.x + g->dst.w, y1 = g->dst.y + g->dst.h;
+            float u0 = (float)g->src.x / w, v0 = (float)g->src.y / h;
+            float u1 = (float)(g->src.x + g->src.w) / w, v1 = (float)(g->src.y + g->src.h) / h;
+
+            // top left, top right, bottom left, bottom right
+            SDL_Vertex * v = &run->vertices_[run->quads_ * 4];
+            v[0] = (SDL_Vertex){ { x0, y0 }, white, { u0, v0 } };
+            v[1] = (SDL_Vertex){ { x1, y0 }, white, { u1, v0 } };
+            v[2] = (SDL_Vertex){ { x0, y1 }, white, { u0, v1 } };
+            v[3] = (SDL_Vertex){ { x1, y1 }, white, { u1, v1 } };
+            run->quads_++;
+            l->count_++;
+        }
+        if (l->count_ > 0) {
+            run->level_count_++;
+        }
+    }
+
+    free(glyphs);
+}
+
+const text_run * text_cache_get(text_cache * cache, sc_ushort font_index, FC_Font * font, const sc_char * text) {
+    if (font == NULL) {
+        return NULL;
+    }
+
+    sc_uint length;
+    sc_uint hash = hash_text(font_index, text, &length);
+    text_run * run = &cache->runs_[hash & (cache->size_ - 1)];
+    if (run->text_ && run->hash_ == hash && run->font_ == font_index &&
+        memcmp(run->text_, text, length + 1) == 0) {
+        cache->hits_++;
+        return run;
+    }
+
+    cache->misses_++;
+    if (run->text_) {
+        free_run(run);
+    }
+    run->font_ = font_index;
+    run->hash_ = hash;
+    run->text_ = (sc_char*)malloc(length + 1);
+    memcpy(run->text_, text, length + 1);
+    layout(run, font, text);
+    return run;
+}
+
+// make sure scratch vertices and shared indices can hold quads
+static void reserve(text_cache * cache, sc_uint quads) {
+    if (quads > cache->scratch_capacity_) {
+        cache->scratch_capacity_ = quads;
+        cache->scratch_ = (SDL_Vertex*)realloc(cache->scratch_, quads * 4 * sizeof(SDL_Vertex));
+    }
+    if (quads > cache->indices_capacity_) {
+        cache->indices_ = (sc_int*)realloc(cache->indices_, quads * 6 * sizeof(sc_int));
+        for (sc_uint q = cache->indices_capacity_; q < quads; q++) {
+            sc_int * i = &cache->indices_[q * 6];
+            i[0] = q * 4;     i[1] = q * 4 + 1; i[2] = q * 4 + 2;
+            i[3] = q * 4 + 2; i[4] = q * 4 + 1; i[5] = q * 4 + 3;
+        }
+        cache->indices_capacity_ = quads;
+    }
+}
+
+sc_uint text_cache_draw(text_cache * cache, SDL_Renderer * renderer, FC_Font * font,
+                        const text_run * run, sc_short x, sc_short y) {
+    if (run == NULL || run->quads_ == 0) {
+        return 0;
+    }
+    reserve(cache, run->quads_);
+
+    SDL_Color colour = FC_GetDefaultColor(font);
+    sc_uint calls = 0;
+    for (sc_uint l = 0; l < run->level_count_; l++) {
+        const text_run_level * level = &run->levels_[l];
+        SDL_Texture * texture = FC_GetGlyphCacheLevel(font, level->cache_level_);
+        if (texture == NULL) {
+            continue;
+        }
+        SDL_SetTextureColorMod(texture, colour.r, colour.g, colour.b);
+        SDL_SetTextureAlphaMod(texture, colour.a);
+
+        const SDL_Vertex * src = &run->vertices_[level->first_ * 4];
+        SDL_Vertex * dst = cache->scratch_;
+        sc_uint vertices = level->count_ * 4;
+        for (sc_uint v = 0; v < vertices; v++) {
+            dst[v] = src[v];
+            dst[v].position.x += x;
+            dst[v].position.y += y;
+        }
+
+#if USE_GEOMETRY
+        SDL_RenderGeometry(renderer, texture, dst, vertices, cache->indices_, level->count_ * 6);
+        calls++;
+#else
+        sc_int w, h;
+        SDL_QueryTexture(texture, NULL, NULL, &w, &h);
+        for (sc_uint q = 0; q < level->count_; q++) {
+            const SDL_Vertex * v = &dst[q * 4];
+            SDL_Rect s = { v[0].tex_coord.x * w + 0.5f, v[0].tex_coord.y * h + 0.5f,
+                           (v[3].tex_coord.x - v[0].tex_coord.x) * w + 0.5f,
+                           (v[3].tex_coord.y - v[0].tex_coord.y) * h + 0.5f };
+            SDL_Rect d = { v[0].position.x, v[0].position.y,
+                           v[3].position.x - v[0].position.x, v[3].position.y - v[0].position.y };
+            SDL_RenderCopy(renderer, texture, &s, &d);
+            calls++;
+        }
+#endif
+    }
+    return calls;
+}
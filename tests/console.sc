@@ -0,0 +1,30 @@
+; bulk console output, each command writes a whole value in one instruction,
+; output is buffered and written out by the console's own thread
+
+@segment .code
+
+@entry
+    MOVL R0 "count: "
+    .Console/str R0         ; up to '\0'
+
+    MOVL R1 #-42
+    LDR R1 R1
+    .Console/int R1         ; signed decimal
+
+    MOVL R0 "\nscale: "
+    .Console/str R0
+    MOVL R1 #30.45
+    LDR R1 R1
+    .Console/float R1       ; as printf %g
+
+    MOVL R1 #10             ; '\n'
+    LDR R1 R1
+    .Console/write R1       ; a single byte
+
+    MOVL R0 "first five of this"
+    MOVL R1 #5
+    LDR R1 R1
+    .Console/strn R0 R1     ; exactly R1 bytes
+    MOVL R0 "\n"
+    .Console/str R0
+    HALT
@@ -0,0 +1,33 @@
+; echo stdin back to the console, a line at a time, until stdin is closed,
+; e.g. printf "one\ntwo\n" | scem echo.scrom
+; the task keeps running at its rate while waiting, it never blocks on a read
+
+@segment .code
+
+@task _echo:
+    MOVL R1 #-1             ; sent once stdin is closed
+    LDR R1 R1
+_next:
+    SREAD R0 S0
+    JMPZ _got
+    YIELD                   ; nothing to read yet
+    JMP _next
+_got:
+    CMP R0 R1
+    JMPZ _done
+    .Console/write R0
+    JMP _next
+_done:
+    HALT
+
+@entry
+    MOVL R0 #0
+    LDR R0 R0
+    @stream S0 #32 R0 #0
+    MOVL R0 #1              ; 0 sends each byte as it is read, 1 a whole line at a time
+    LDR R0 R0
+    @attach G3 S0 R0
+    MOVL R0 #1000
+    LDR R0 R0
+    SPAWN R0 _echo
+    START
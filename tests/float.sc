@@ -0,0 +1,30 @@
+; ADDF, SUBF and MULF take floats, as made by ITOF or a float literal, and their
+; results can be used again, prints 2.5 -0.5 1.5 4
+
+@segment .code
+
+; prints float %1 and a space, using %2
+@macro PRINT
+    .Console/float %1
+    MOVL %2 " "
+    .Console/str %2
+@endmacro
+
+@entry
+    MOVL R1 #1.5
+    LDR R1 R1
+    MOVL R2 #1
+    LDR R2 R2
+    ITOF R2 R2
+    ADDF R3 R1 R2
+    PRINT R3 R22
+    SUBF R4 R2 R1
+    PRINT R4 R22
+    MULF R5 R1 R2
+    PRINT R5 R22
+    ADDF R6 R3 R1
+    FTOI R6 R6
+    .Console/int R6
+    MOVL R22 "\n"
+    .Console/str R22
+    HALT
@@ -0,0 +1,40 @@
+; draw into a framebuffer in VM memory and present it with .Screen/blit
+;
+; .Screen/framebuffer Raddr Rsize   32-bit ARGB pixels at Raddr, Rsize is width << 16 | height
+; .Screen/blit Rxy Rsize            upload and draw rectangle, Rxy is x << 16 | y
+
+@segment .code
+@entry
+    MOVL R0 #64
+    LDR R0 R0
+    .Screen/resize R0 R0
+    MOVL R1 #65536
+    LDR R1 R1           ; framebuffer address, past the literals
+    MOVL R2 #4194368
+    LDR R2 R2           ; 64 << 16 | 64
+    .Screen/framebuffer R1 R2
+
+    ; gradient, pixel i = i
+    MOVL R3 #0
+    LDR R3 R3
+    MOVL R4 #4096
+    LDR R4 R4
+    MOVL R5 #1
+    LDR R5 R5
+    MOVL R6 #4
+    LDR R6 R6
+    MOV R7 R1
+_fill:
+    STR R7 R3
+    ADD R7 R7 R6
+    ADD R3 R3 R5
+    CMP R3 R4
+    JMPNZ _fill
+
+    .Screen/begin
+    .Screen/fill
+    MOVL R8 #0
+    LDR R8 R8
+    .Screen/blit R8 R2
+    .Screen/end
+    HALT
@@ -0,0 +1,78 @@
+; palette animation with an 8-bit indexed framebuffer
+;
+; .Screen/indexed Raddr Rsize    8-bit palette indices at Raddr, Rsize is width << 16 | height
+; .Screen/palette Raddr Rcount   Rcount 32-bit ARGB entries at Raddr, replacing palette from 0
+;
+; the framebuffer is drawn once, each frame only the palette changes
+
+@segment .code
+
+@task _animate:
+    MOVL R1 #65536
+    LDR R1 R1           ; framebuffer address
+    MOVL R2 #4194368
+    LDR R2 R2           ; 64 << 16 | 64
+    MOVL R3 #131072
+    LDR R3 R3           ; palette address
+    MOVL R4 #256
+    LDR R4 R4
+    MOVL R5 #1
+    LDR R5 R5
+    MOVL R6 #4
+    LDR R6 R6
+    MOVL R10 #0
+    LDR R10 R10
+    MOVL R11 #4278190080
+    LDR R11 R11         ; opaque alpha
+    MOVL R12 #65793
+    LDR R12 R12         ; 0x010101, grey
+    MOVL R13 #255
+    LDR R13 R13
+    .Screen/indexed R1 R2
+
+    ; pixel i = i & 255
+    MOVL R7 #4096
+    LDR R7 R7
+    MOV R8 R10
+    MOV R9 R1
+_pixels:
+    STRB R9 R8
+    ADD R9 R9 R5
+    ADD R8 R8 R5
+    CMP R8 R7
+    JMPNZ _pixels
+
+    MOV R0 R10          ; frame
+_frame:
+    ; rotate grey ramp, entry i = (i + frame) & 255
+    MOV R8 R10
+    MOV R9 R3
+_entries:
+    ADD R14 R8 R0
+    AND R14 R14 R13
+    MUL R14 R14 R12
+    OR R14 R14 R11
+    STR R9 R14
+    ADD R9 R9 R6
+    ADD R8 R8 R5
+    CMP R8 R4
+    JMPNZ _entries
+    .Screen/palette R3 R4
+
+    .Screen/begin
+    .Screen/blit R10 R2
+    .Screen/end
+    YIELD
+    ADD R0 R0 R5
+    CMP R0 R4
+    JMPNZ _frame
+    HALT
+
+@entry
+    MOVL R0 #64
+    LDR R0 R0
+    .Screen/resize R0 R0
+    MOVL R0 #60
+    LDR R0 R0
+    SPAWN R0 _animate
+    START
@@ -0,0 +1,39 @@
+; blocks scasm -P lays out by a profile, prints 99999 1 with and without, e.g.
+;   scasm layout.sc layout.scrom
+;   scem --profile layout.scrom
+;   scasm -Playout.scrom.prof layout.sc layout.scrom
+
+@segment .code
+
+@entry
+    MOVL R0 #0
+    LDR R0 R0           ; i
+    MOVL R1 #100000
+    LDR R1 R1           ; n
+    MOVL R2 #1
+    LDR R2 R2
+    MOVL R3 #0
+    LDR R3 R3           ; common
+    MOV R5 R3           ; rare
+    MOVL R4 #50000
+    LDR R4 R4
+_loop:
+    CMP R0 R4
+    JMPZ _rare
+    ADD R3 R3 R2        ; hot, so falls through to _next once laid out
+    JMP _next
+_rare:
+    ADD R5 R5 R2        ; cold, so moved to the end
+_next:
+    ADD R0 R0 R2
+    CMP R0 R1
+    JMPZ _done
+    JMP _loop
+_done:
+    .Console/int R3
+    MOVL R6 " "
+    .Console/str R6
+    .Console/int R5
+    MOVL R6 "\n"
+    .Console/str R6
+    HALT
@@ -0,0 +1,24 @@
+; routines shared by the sample programs, see @include in t3.sc
+
+@segment .code
+
+; functions can declare a register window with @window, registers in the
+; window are saved on CALL and restored on RET
+
+; routine to print string to console
+; R0 is pointer to start of string, R0-R2 are preserved
+@func _print_str:
+@window R0 R2
+    MOVL R2 #0
+    LDR R2 R2
+_loop:
+    LDRSB R1 R0         ; load byte from memory
+    CMP R1 R2           ; is byte == '\0'
+    JMPZ _exit_loop     ; if so exit loop
+    .Console/write R1   ; otherwise write byte to console
+    MOVL R1 #1
+    LDR R1 R1
+    ADD R0 R0 R1
+    JMP _loop           ; jump to start of loop
+_exit_loop:
+    RET
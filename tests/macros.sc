@@ -0,0 +1,69 @@
+; @macro, and with scasm -O small functions inlined, prints 3 2 1 2 1 10 0 1
+
+@segment .code
+
+; %1 = %2, e.g. LOADI R1 #3
+@macro LOADI
+    MOVL %1 %2
+    LDR %1 %1
+@endmacro
+
+; prints %1 and a space, using %2
+@macro PRINT
+    .Console/int %1
+    MOVL %2 " "
+    .Console/str %2
+@endmacro
+
+; prints %1 down to 1, its labels are its own in each expansion
+@macro COUNTDOWN
+    LOADI R20 #1
+    LOADI R21 #0
+_again:
+    PRINT %1 R22
+    SUB %1 %1 R20
+    CMP %1 R21
+    JMPNZ _again
+@endmacro
+
+; jumps to %2 if %1 is zero, %2 is a label where the macro is used
+@macro JZERO
+    LOADI R21 #0
+    CMP %1 R21
+    JMPZ %2
+@endmacro
+
+; prints 0 if R1 is zero, otherwise 1
+@func _sign:
+    LOADI R2 #0
+    JZERO R1 _print
+    LOADI R2 #1
+_print:
+    PRINT R2 R22
+    RET
+
+; small leaf, so inlined by scasm -O
+@func _twice:
+    ADD R4 R4 R4
+    RET
+
+@entry
+    JMP _start
+; same name as COUNTDOWN's own label, which must not bind to it
+_again:
+    HALT
+_start:
+    LOADI R1 #3
+    COUNTDOWN R1
+    LOADI R1 #2
+    COUNTDOWN R1
+    LOADI R4 #5
+    CALL _twice
+    PRINT R4 R22
+    LOADI R1 #0
+    CALL _sign
+    LOADI R1 #4
+    CALL _sign
+    MOVL R22 "\n"
+    .Console/str R22
+    HALT
@@ -0,0 +1,66 @@
+; patterns scasm -O rewrites, assemble with and without -O and compare,
+; both print 1 2 3 4 5 6 6
+
+@segment .data
+_counter:
+  WORD #1 #0
+
+@segment .code
+
+; prints _counter, R5 is preserved
+@func _show:
+@window R5 R5
+    MOVL R6 _counter
+    LDR R6 R6
+    .Console/int R6
+    MOVL R6 " "
+    .Console/str R6
+    RET
+
+@func _bump:
+    MOVL R1 _counter
+    LDR R2 R1
+    MOVL R3 #1
+    LDR R3 R3
+    ADD R2 R2 R3
+    MOVL R1 _counter        ; reload of address in R1
+    STR R1 R2
+    MOV R2 R2               ; self move
+    MOVL R1 _counter        ; reload again
+    LDR R2 R1
+    CALL _show              ; not a tail call, _show's window is not within _bump's
+    RET
+
+@func _twice:
+@window R5 R6
+    CALL _bump
+    CALL _bump              ; tail call, _bump has no window
+    RET
+    NOP                     ; unreachable
+    NOP
+
+@entry
+    MOVL R7 #3
+    LDR R7 R7
+    MOVL R8 #1
+    LDR R8 R8
+    MOVL R9 #0
+    LDR R9 R9
+_loop:
+    CALL _twice
+    SUB R7 R7 R8
+    CMP R7 R9
+    JMPZ _done
+    JMP _again
+_again:
+    JMP _loop
+_done:
+    MOVL R6 _counter
+    LDR R6 R6
+    MOVL R6 _counter
+    LDR R6 R6               ; redundant reload
+    .Console/int R6
+    MOVL R6 "\n"
+    .Console/str R6
+    HALT
+    HALT
@@ -1,6 +1,9 @@
-;@include "lib.sc"
+; _print_str, found next to this file or in a -I path
+@include "lib.sc"
 
-; we really need a calling convention :-) :-)
+; rasterize the font loaded below at assembly time, so it is not loaded
+; from the TTF at run time
+@font "./assets/square.ttf" #14
 
 @segment .data
 _x: 
@@ -20,22 +23,6 @@ _font14:
 
 @segment .code
 
-; routine to print string to console
-@func _print_str:
-    MOVL R2 #0
-    LDR R2 R2
-_loop:
-    LDRSB R1 R0         ; load byte from memory
-    CMP R1 R2           ; is byte == '\0'
-    JMPZ _exit_loop     ; if so exit loop
-    .Console/write R1   ; otherwise write byte to console
-    MOVL R1 #1
-    LDR R1 R1
-    ADD R0 R0 R1
-    JMP _loop           ; jump to start of loop
-_exit_loop:
-    RET
-
 @task _display:
 _start:
     ; initialize x,y position
@@ -45,6 +32,10 @@ _start:
     MOVL R11 _y
     LDR R11 R11
 
+    ; fonts load in the background, wait for the one from _init before drawing,
+    ; .Screen/fontready R0 R1 could be polled instead, it sets cmp flag when ready
+    @await
+
 _start_after:
 
     ;@await SREAD R0 S0  ; wait until their is a mouse movement (x, y) 
@@ -109,7 +100,11 @@ _nomouse:
     ; button status is read via API 
     ; for now we are just assuming G1 is connected to the mouse!!
     MOVL R0 #30 ; sample mouse events at 30hz
-    @stream S0 #32 R0 #0   ; mouse messages are 32-bit lower 16-bits are x and top y position
+    LDR R0 R0
+    ; mouse messages are 32-bit lower 16-bits are x and top y position, motion
+    ; faster than the rate is coalesced, #2 sends a position only once the last 
+    ; one has been read, button presses are always sent
+    @stream S0 #32 R0 #2
     MOVL R0 #1
     @attach G1 S0 R0
     
@@ -120,7 +115,18 @@ _nomouse:
     LDR R1 R1
     .Screen/resize R0 R1
 
-    ; load font... (14pt square.ttf in black)
+    ; retained mode, only the area that changed, e.g. the cursor, is redrawn
+    MOVL R2 #1
+    LDR R2 R2
+    .Screen/retain R2
+
+    ; render at most 30 frames per second, the same rate as the display task
+    MOVL R2 #30
+    LDR R2 R2
+    .Screen/rate R2
+
+    ; load font... (14pt square.ttf in black), this returns straight away
+    ; and the font is ready some frames later
     MOVL R2 #0                    ; colour index (black) 
     LDR R2 R2
     .Screen/colour R2